@@ -0,0 +1,41 @@
+/*
+ * Copyright 2023 Clement Vuchener
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef ALLOCATION_COUNTER_H
+#define ALLOCATION_COUNTER_H
+
+#include <cstddef>
+
+// Counters for the global operator new, used by --stats.
+//
+// operator new is only replaced in builds with COUNT_ALLOCATIONS, the
+// counters stay at zero otherwise.
+struct AllocationCounter
+{
+	std::size_t count = 0;
+	std::size_t bytes = 0;
+
+	static bool enabled();
+	static AllocationCounter current();
+
+	AllocationCounter operator-(const AllocationCounter &other) const {
+		return {count - other.count, bytes - other.bytes};
+	}
+};
+
+#endif
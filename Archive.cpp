@@ -0,0 +1,277 @@
+/*
+ * Copyright 2023 Clement Vuchener
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "Archive.h"
+
+#include <algorithm>
+#include <cstring>
+#include <format>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#ifdef HAVE_ZLIB
+#include <zlib.h>
+#endif
+
+#include "MappedFile.h"
+#include "OutputFile.h"
+
+namespace fs = std::filesystem;
+
+namespace {
+
+struct Member
+{
+	std::string path;
+	std::string content;
+};
+
+enum class Format { Tar, TarGz, Zip };
+
+Format archive_format(const fs::path &path)
+{
+	auto name = path.filename().string();
+	if (name.ends_with(".tar.gz") || name.ends_with(".tgz"))
+		return Format::TarGz;
+	if (name.ends_with(".zip"))
+		return Format::Zip;
+	return Format::Tar;
+}
+
+std::string inflate_data(std::string_view data, int window_bits, std::size_t size_hint)
+{
+#ifdef HAVE_ZLIB
+	z_stream stream = {};
+	if (inflateInit2(&stream, window_bits) != Z_OK)
+		throw std::runtime_error("inflateInit2 failed");
+	std::string out(std::max<std::size_t>(size_hint, 4*data.size()), '\0');
+	stream.next_in = reinterpret_cast<Bytef *>(const_cast<char *>(data.data()));
+	stream.avail_in = data.size();
+	int ret;
+	do {
+		if (stream.total_out == out.size())
+			out.resize(2*out.size());
+		stream.next_out = reinterpret_cast<Bytef *>(out.data() + stream.total_out);
+		stream.avail_out = out.size() - stream.total_out;
+		ret = inflate(&stream, Z_NO_FLUSH);
+	} while (ret == Z_OK);
+	out.resize(stream.total_out);
+	inflateEnd(&stream);
+	if (ret != Z_STREAM_END)
+		throw std::runtime_error(std::format("invalid compressed data: {}", stream.msg ? stream.msg : "truncated"));
+	return out;
+#else
+	(void)data;
+	(void)window_bits;
+	(void)size_hint;
+	throw std::runtime_error("compressed archives are not supported (built without zlib)");
+#endif
+}
+
+std::size_t parse_octal(std::string_view field)
+{
+	std::size_t value = 0;
+	for (char c: field) {
+		if (c >= '0' && c <= '7')
+			value = value * 8 + (c - '0');
+		else if (c != ' ' && c != '\0')
+			break;
+	}
+	return value;
+}
+
+std::string_view c_string(std::string_view field)
+{
+	return field.substr(0, std::min(field.find('\0'), field.size()));
+}
+
+// ustar with GNU long names and pax path records
+std::vector<Member> read_tar(std::string_view data)
+{
+	static constexpr std::size_t BlockSize = 512;
+	std::vector<Member> members;
+	std::string long_name;
+	while (data.size() >= BlockSize) {
+		auto header = data.substr(0, BlockSize);
+		if (header.find_first_not_of('\0') == header.npos)
+			break; // end of archive
+		auto size = parse_octal(header.substr(124, 12));
+		char type = header[156];
+		auto padded_size = (size + BlockSize - 1) / BlockSize * BlockSize;
+		if (BlockSize + size > data.size())
+			throw std::runtime_error("truncated tar archive");
+		auto content = data.substr(BlockSize, size);
+		data.remove_prefix(std::min(data.size(), BlockSize + padded_size));
+
+		if (type == 'L') {
+			long_name = c_string(content);
+			continue;
+		}
+		if (type == 'x') {
+			// pax records: "<length> <key>=<value>\n"
+			for (std::string_view records = content; !records.empty(); ) {
+				auto space = records.find(' ');
+				if (space == records.npos)
+					break;
+				std::size_t length = 0;
+				for (char c: records.substr(0, space))
+					length = length * 10 + (c - '0');
+				if (length <= space + 1 || length > records.size())
+					break;
+				auto record = records.substr(space + 1, length - space - 2);
+				if (record.starts_with("path="))
+					long_name = record.substr(5);
+				records.remove_prefix(length);
+			}
+			continue;
+		}
+		std::string path;
+		if (!long_name.empty())
+			path = std::move(long_name);
+		else if (header.substr(257, 5) == "ustar" && header[345] != '\0')
+			path = std::format("{}/{}", c_string(header.substr(345, 155)), c_string(header.substr(0, 100)));
+		else
+			path = c_string(header.substr(0, 100));
+		long_name.clear();
+		if (type == '0' || type == '\0')
+			members.push_back({std::move(path), std::string(content)});
+	}
+	return members;
+}
+
+template <typename T>
+T read_le(std::string_view data, std::size_t offset)
+{
+	if (offset + sizeof(T) > data.size())
+		throw std::runtime_error("truncated zip archive");
+	T value = 0;
+	for (std::size_t i = 0; i < sizeof(T); ++i)
+		value |= T(static_cast<unsigned char>(data[offset + i])) << (8*i);
+	return value;
+}
+
+std::vector<Member> read_zip(std::string_view data)
+{
+	// The end of central directory record is at the end, followed by a
+	// comment of at most 65535 bytes.
+	static constexpr std::size_t EndRecordSize = 22;
+	if (data.size() < EndRecordSize)
+		throw std::runtime_error("not a zip archive");
+	std::size_t end_record = data.size() - EndRecordSize;
+	std::size_t search_limit = end_record > 0xffff ? end_record - 0xffff : 0;
+	while (read_le<std::uint32_t>(data, end_record) != 0x06054b50) {
+		if (end_record == search_limit)
+			throw std::runtime_error("not a zip archive");
+		--end_record;
+	}
+	auto entry_count = read_le<std::uint16_t>(data, end_record + 10);
+	std::size_t entry = read_le<std::uint32_t>(data, end_record + 16);
+	if (entry_count == 0xffff || entry == 0xffffffff)
+		throw std::runtime_error("zip64 archives are not supported");
+
+	std::vector<Member> members;
+	for (unsigned int i = 0; i < entry_count; ++i) {
+		if (read_le<std::uint32_t>(data, entry) != 0x02014b50)
+			throw std::runtime_error("invalid zip central directory");
+		auto method = read_le<std::uint16_t>(data, entry + 10);
+		std::size_t compressed_size = read_le<std::uint32_t>(data, entry + 20);
+		std::size_t size = read_le<std::uint32_t>(data, entry + 24);
+		auto name_length = read_le<std::uint16_t>(data, entry + 28);
+		auto extra_length = read_le<std::uint16_t>(data, entry + 30);
+		auto comment_length = read_le<std::uint16_t>(data, entry + 32);
+		std::size_t local_header = read_le<std::uint32_t>(data, entry + 42);
+		std::string path(data.substr(entry + 46, name_length));
+		entry += 46 + name_length + extra_length + comment_length;
+		if (path.ends_with('/'))
+			continue; // directory
+
+		if (read_le<std::uint32_t>(data, local_header) != 0x04034b50)
+			throw std::runtime_error("invalid zip local header");
+		auto content_offset = local_header + 30
+			+ read_le<std::uint16_t>(data, local_header + 26)
+			+ read_le<std::uint16_t>(data, local_header + 28);
+		if (content_offset + compressed_size > data.size())
+			throw std::runtime_error("truncated zip archive");
+		auto content = data.substr(content_offset, compressed_size);
+		switch (method) {
+		case 0: // stored
+			members.push_back({std::move(path), std::string(content)});
+			break;
+		case 8: // deflated
+			members.push_back({std::move(path), inflate_data(content, -15, size)});
+			break;
+		default:
+			throw std::runtime_error(std::format("unsupported compression method {} for {}", method, path));
+		}
+	}
+	return members;
+}
+
+} // namespace
+
+bool is_structures_archive(const fs::path &path)
+{
+	auto name = path.filename().string();
+	return fs::is_regular_file(path) &&
+		(name.ends_with(".tar") || name.ends_with(".tar.gz") ||
+		 name.ends_with(".tgz") || name.ends_with(".zip"));
+}
+
+static fs::path memory_directory()
+{
+#ifdef __linux__
+	if (fs::is_directory("/dev/shm"))
+		return "/dev/shm";
+#endif
+	return fs::temp_directory_path();
+}
+
+std::unique_ptr<StagingDirectory> extract_structures_archive(const fs::path &archive)
+{
+	MappedFile file(archive);
+	std::vector<Member> members;
+	switch (archive_format(archive)) {
+	case Format::Tar:
+		members = read_tar(file.view());
+		break;
+	case Format::TarGz:
+		// 15+16: gzip header
+		members = read_tar(inflate_data(file.view(), 15 + 16, 0));
+		break;
+	case Format::Zip:
+		members = read_zip(file.view());
+		break;
+	}
+
+	// Keep the XML files from the shallowest directory containing some
+	auto is_xml = [](const Member &m) { return m.path.ends_with(".xml"); };
+	auto depth = [](const Member &m) { return std::ranges::count(m.path, '/'); };
+	std::erase_if(members, [&](const Member &m) { return !is_xml(m); });
+	if (members.empty())
+		throw std::runtime_error(std::format("no XML file in {}", archive.string()));
+	auto base = fs::path(std::ranges::min(members, {}, depth).path).parent_path();
+	std::erase_if(members, [&](const Member &m) { return fs::path(m.path).parent_path() != base; });
+
+	// never committed, the destructor removes it
+	auto staging = std::make_unique<StagingDirectory>(memory_directory() / "dt-memory-layout-archive");
+	for (const auto &member: members)
+		staging->writeFile(fs::path(member.path).filename().string(), member.content);
+	return staging;
+}
@@ -0,0 +1,41 @@
+/*
+ * Copyright 2023 Clement Vuchener
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef ARCHIVE_H
+#define ARCHIVE_H
+
+#include <filesystem>
+#include <memory>
+
+#include "OutputFile.h"
+
+// df-structures snapshots in .tar, .tar.gz/.tgz or .zip archives.
+//
+// Compressed formats (.tar.gz and deflated zip members) require zlib.
+
+bool is_structures_archive(const std::filesystem::path &path);
+
+// Decompress the archive in memory and write its XML files to a temporary
+// directory, removed when the returned staging directory is destroyed.
+// The structures can only be loaded from a directory, so it is created in
+// memory-backed storage (/dev/shm) when available to keep the files off
+// the disk. The XML files are taken from the shallowest directory of the
+// archive containing any, so snapshots with a top-level directory work too.
+std::unique_ptr<StagingDirectory> extract_structures_archive(const std::filesystem::path &archive);
+
+#endif
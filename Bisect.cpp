@@ -0,0 +1,158 @@
+/*
+ * Copyright 2023 Clement Vuchener
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "Bisect.h"
+
+#include <format>
+#include <iostream>
+#include <map>
+#include <optional>
+
+#include <dfs/Structures.h>
+#include <dfs/ABI.h>
+#include <dfs/MemoryLayout.h>
+using namespace dfs;
+
+#include "Generator.h"
+#include "Ini.h"
+
+namespace fs = std::filesystem;
+
+namespace {
+
+class EntryProbe
+{
+public:
+	EntryProbe(GitRepository &repository, pugi::xml_node entry, const char *version_name,
+		   fs::path cache_root):
+		_repository(repository),
+		_entry(entry),
+		_version_name(version_name),
+		_cache_root(std::move(cache_root))
+	{
+	}
+
+	// The entry value at rev, or nullopt if it cannot be evaluated
+	std::optional<std::size_t> value(const std::string &rev)
+	{
+		auto tree = _repository.read(std::format("{}^{{tree}}", rev)).oid;
+		auto [it, inserted] = _values.try_emplace(tree);
+		if (inserted)
+			it->second = evaluate(rev);
+		return it->second;
+	}
+
+private:
+	std::optional<std::size_t> evaluate(const std::string &rev)
+	{
+		try {
+			Structures structures(_repository.extractXml(rev, _cache_root));
+			auto version = structures.versionByName(_version_name);
+			if (!version)
+				throw std::runtime_error(std::format("version {} not found", _version_name));
+			const ABI &abi = ABI::fromVersionName(_version_name);
+			MemoryLayout layout(structures, abi);
+			dtml::Generator generator(structures, *version, abi, layout);
+			auto value = generator.evaluateEntry(_entry);
+			std::cerr << std::format("{}: {}\n", rev.substr(0, 12), dtml::hex_value{value});
+			return value;
+		}
+		catch (std::exception &e) {
+			std::cerr << std::format("{}: {}\n", rev.substr(0, 12), e.what());
+			return std::nullopt;
+		}
+	}
+
+	GitRepository &_repository;
+	pugi::xml_node _entry;
+	const char *_version_name;
+	fs::path _cache_root;
+	std::map<std::string, std::optional<std::size_t>> _values; // by tree id
+};
+
+std::string format_value(const std::optional<std::size_t> &value)
+{
+	return value ? std::format("{}", dtml::hex_value{*value}) : std::string("(error)");
+}
+
+std::string commit_subject(GitRepository &repository, const std::string &rev)
+{
+	auto commit = repository.read(rev).content;
+	auto message = commit.find("\n\n");
+	if (message == commit.npos)
+		return {};
+	auto end = commit.find('\n', message + 2);
+	return commit.substr(message + 2, end == commit.npos ? end : end - message - 2);
+}
+
+} // namespace
+
+int bisect_entry(GitRepository &repository,
+		 std::string_view range,
+		 std::string_view entry,
+		 const char *version_name,
+		 const fs::path &memory_layout_xml,
+		 const fs::path &cache_root)
+{
+	auto dots = range.find("..");
+	auto slash = entry.find('/');
+	// OLD...NEW is a symmetric difference, OLD is not an ancestor of
+	// every revision in it
+	if (dots == range.npos || range.find("...") != range.npos || slash == entry.npos) {
+		std::cerr << std::format("Expected a OLD..NEW revision range and a SECTION/NAME entry\n");
+		return EXIT_FAILURE;
+	}
+	std::string old_rev(range.substr(0, dots));
+
+	dtml::LayoutDescription description(memory_layout_xml);
+	auto entry_node = description.findEntry(entry.substr(0, slash), entry.substr(slash + 1));
+	if (!entry_node) {
+		std::cerr << std::format("Entry {} not found in {}\n", entry, memory_layout_xml.string());
+		return EXIT_FAILURE;
+	}
+
+	// candidates[0] is the old revision, the value changes somewhere after
+	auto candidates = repository.revList({"--first-parent", "--reverse", std::string(range)});
+	// peel annotated tags, rev-list gives commit ids
+	candidates.insert(candidates.begin(), repository.read(old_rev + "^{commit}").oid);
+
+	EntryProbe probe(repository, entry_node, version_name, cache_root);
+	auto old_value = probe.value(candidates.front());
+	auto new_value = probe.value(candidates.back());
+	if (old_value == new_value) {
+		std::cout << std::format("{} is {} at both ends of the range\n", entry, format_value(old_value));
+		return EXIT_SUCCESS;
+	}
+
+	// invariant: value(lo) == old_value, value(hi) != old_value
+	std::size_t lo = 0, hi = candidates.size() - 1;
+	while (hi - lo > 1) {
+		auto mid = lo + (hi - lo) / 2;
+		if (probe.value(candidates[mid]) == old_value)
+			lo = mid;
+		else
+			hi = mid;
+	}
+	std::cout << std::format("{} changed from {} to {} in {} {}\n",
+			entry,
+			format_value(old_value),
+			format_value(probe.value(candidates[hi])),
+			candidates[hi],
+			commit_subject(repository, candidates[hi]));
+	return EXIT_SUCCESS;
+}
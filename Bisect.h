@@ -0,0 +1,41 @@
+/*
+ * Copyright 2023 Clement Vuchener
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef BISECT_H
+#define BISECT_H
+
+#include <filesystem>
+#include <string_view>
+
+#include "GitRepository.h"
+
+// Binary search the first df-structures revision in the range old..new
+// where the value of an entry ("section/name" in the memory layout XML)
+// changes for a version.
+//
+// Each probed revision is extracted in the cache and its structures are
+// loaded; evaluated values are kept per tree, so commits that did not
+// change the XML files are not loaded again.
+int bisect_entry(GitRepository &repository,
+		 std::string_view range,
+		 std::string_view entry,
+		 const char *version_name,
+		 const std::filesystem::path &memory_layout_xml,
+		 const std::filesystem::path &cache_root);
+
+#endif
@@ -0,0 +1,110 @@
+/*
+ * Copyright 2023 Clement Vuchener
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+#include "ContainerLayout.h"
+
+#include <format>
+#include <stdexcept>
+
+#include <dfs/Type.h>
+
+#include "Ini.h"
+
+using namespace dfs;
+
+namespace dtml {
+
+static bool is_msvc(const ABI &abi)
+{
+	return &abi == &ABI::MSVC2015_32 || &abi == &ABI::MSVC2015_64;
+}
+
+ContainerLayout container_layout(const ABI &abi)
+{
+	const std::size_t p = abi.pointer.size;
+	const std::size_t string_size = abi.primitive_types[PrimitiveType::StdString].size;
+	ContainerLayout c = {};
+	c.pointer_size = p;
+
+	// Both libstdc++ and MSVC (without debug iterators) store three
+	// pointers: first, last and end of storage.
+	c.vector_size = 3*p;
+	c.vector_begin = 0;
+	c.vector_end = p;
+	c.vector_capacity = 2*p;
+
+	if (is_msvc(abi)) {
+		// union { char buf[16]; char *ptr; }, size_t size, size_t res
+		c.string_kind = ContainerLayout::StringKind::Msvc;
+		c.string_buffer = 0;
+		c.string_buffer_size = 16;
+		c.string_data = 0;
+		c.string_length = 16;
+		c.string_capacity = 16 + p;
+		c.string_size = 16 + 2*p;
+	}
+	else if (string_size == p) {
+		// char *p, pointing after { size_t length, capacity; int refcount; }
+		c.string_kind = ContainerLayout::StringKind::LibStdCxxCow;
+		c.string_data = 0;
+		c.string_header_size = 3*p;
+		c.string_length = 0;
+		c.string_capacity = p;
+		c.string_size = p;
+	}
+	else {
+		// char *p, size_t length, union { char buf[16]; size_t capacity; }
+		c.string_kind = ContainerLayout::StringKind::LibStdCxx;
+		c.string_data = 0;
+		c.string_length = p;
+		c.string_buffer = 2*p;
+		c.string_buffer_size = 16;
+		c.string_capacity = 2*p;
+		c.string_size = 2*p + 16;
+	}
+	if (c.string_size != string_size)
+		throw std::runtime_error(std::format("unknown std::string layout of size {}",
+				hex_value{string_size}));
+	return c;
+}
+
+Section container_layout_section(std::string_view name, const ContainerLayout &c)
+{
+	Section section = {Section::Kind::Values, std::string(name), {}};
+	auto add = [&section](std::string_view entry, std::size_t value) {
+		section.entries.push_back({std::string(entry), value});
+	};
+	add("pointer_size", c.pointer_size);
+	add("vector_size", c.vector_size);
+	add("vector_begin", c.vector_begin);
+	add("vector_end", c.vector_end);
+	add("vector_capacity", c.vector_capacity);
+	add("string_kind", static_cast<std::size_t>(c.string_kind));
+	add("string_size", c.string_size);
+	add("string_data", c.string_data);
+	add("string_length", c.string_length);
+	add("string_capacity", c.string_capacity);
+	if (c.string_kind == ContainerLayout::StringKind::LibStdCxxCow)
+		add("string_header_size", c.string_header_size);
+	else {
+		add("string_buffer", c.string_buffer);
+		add("string_buffer_size", c.string_buffer_size);
+	}
+	return section;
+}
+
+} // namespace dtml
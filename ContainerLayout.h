@@ -0,0 +1,72 @@
+/*
+ * Copyright 2023 Clement Vuchener
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+#ifndef DTML_CONTAINER_LAYOUT_H
+#define DTML_CONTAINER_LAYOUT_H
+
+#include <cstdint>
+#include <string_view>
+
+#include <dfs/ABI.h>
+
+#include "Generator.h"
+
+namespace dtml {
+
+// Internal layout of the standard containers used by a version, all
+// offsets are in bytes from the start of the container object.
+struct ContainerLayout
+{
+	enum class StringKind: std::uint8_t {
+		LibStdCxx = 1,		// data pointer, length, inline buffer (C++11 ABI)
+		LibStdCxxCow = 2,	// data pointer to a shared buffer
+		Msvc = 3,		// inline buffer or data pointer, length, capacity
+	};
+
+	std::size_t pointer_size;
+
+	std::size_t vector_size;
+	std::size_t vector_begin;
+	std::size_t vector_end;
+	std::size_t vector_capacity;
+
+	StringKind string_kind;
+	std::size_t string_size;
+	std::size_t string_data;	// offset of the data pointer
+	// libstdc++ and MSVC: length and capacity are in the object, the
+	// capacity of libstdc++ shares its storage with the inline buffer.
+	// COW: they are in a header of string_header_size bytes before the
+	// data, at these offsets from the start of the header.
+	std::size_t string_length;
+	std::size_t string_capacity;
+	std::size_t string_buffer;	// offset of the inline buffer (not COW)
+	std::size_t string_buffer_size;	// data is inline when capacity < buffer size
+	std::size_t string_header_size;	// COW only
+};
+
+// The compiler and pointer size are those of the ABI, libstdc++
+// copy-on-write strings are told apart by the std::string size of the ABI.
+// Throws std::runtime_error if that size matches no known layout.
+ContainerLayout container_layout(const dfs::ABI &abi);
+
+// Section with the container layout as pointer_size, vector_begin, ...
+// string_kind entries.
+Section container_layout_section(std::string_view name, const ContainerLayout &containers);
+
+} // namespace dtml
+
+#endif
@@ -0,0 +1,229 @@
+/*
+ * Copyright 2023 Clement Vuchener
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+#include "CppHeader.h"
+
+#include <algorithm>
+#include <cctype>
+#include <format>
+#include <map>
+#include <ranges>
+#include <set>
+
+#include "Ini.h"
+
+using namespace dfs;
+using namespace pugi;
+
+namespace dtml {
+
+// Sorted for binary search
+static constexpr std::string_view Keywords[] = {
+	"alignas", "alignof", "and", "and_eq", "asm", "auto", "bitand",
+	"bitor", "bool", "break", "case", "catch", "char", "char16_t",
+	"char32_t", "char8_t", "class", "co_await", "co_return", "co_yield",
+	"compl", "concept", "const", "const_cast", "consteval", "constexpr",
+	"constinit", "continue", "decltype", "default", "delete", "do",
+	"double", "dynamic_cast", "else", "enum", "explicit", "export",
+	"extern", "false", "float", "for", "friend", "goto", "if", "inline",
+	"int", "long", "mutable", "namespace", "new", "noexcept", "not",
+	"not_eq", "nullptr", "operator", "or", "or_eq", "private",
+	"protected", "public", "register", "reinterpret_cast", "requires",
+	"return", "short", "signed", "sizeof", "static", "static_assert",
+	"static_cast", "struct", "switch", "template", "this", "thread_local",
+	"throw", "true", "try", "typedef", "typeid", "typename", "union",
+	"unsigned", "using", "virtual", "void", "volatile", "wchar_t", "while",
+	"xor", "xor_eq",
+};
+
+// Names used by the generated structs themselves
+static bool is_reserved(std::string_view id)
+{
+	return std::ranges::binary_search(Keywords, id)
+		|| id == "type_size"
+		|| id.starts_with("_pad_");
+}
+
+static std::string identifier(std::string_view name)
+{
+	std::string id;
+	if (name.empty() || std::isdigit(static_cast<unsigned char>(name.front())))
+		id.push_back('_');
+	for (char c: name)
+		id.push_back(std::isalnum(static_cast<unsigned char>(c)) ? c : '_');
+	if (is_reserved(id))
+		id.push_back('_');
+	return id;
+}
+
+// The structures do not give the base type of enums, they are read as
+// unsigned integers unless they have negative values so that enums based
+// on unsigned types do not sign-extend.
+static bool is_signed_enum(const AbstractType &type)
+{
+	auto enum_type = dynamic_cast<const Enum *>(&type);
+	return enum_type && std::ranges::any_of(enum_type->values | std::views::values,
+			[](const Enum::Value &value) { return value.value < 0; });
+}
+
+// Field type for a member, or an empty string if it must be a byte array
+static std::string_view field_type(const AbstractType &type, TypeKind kind, std::size_t size)
+{
+	auto integer = [size](bool is_signed) -> std::string_view {
+		switch (size) {
+		case 1: return is_signed ? "std::int8_t" : "std::uint8_t";
+		case 2: return is_signed ? "std::int16_t" : "std::uint16_t";
+		case 4: return is_signed ? "std::int32_t" : "std::uint32_t";
+		case 8: return is_signed ? "std::int64_t" : "std::uint64_t";
+		default: return {};
+		}
+	};
+	switch (kind) {
+	case TypeKind::Int8:
+	case TypeKind::Int16:
+	case TypeKind::Int32:
+	case TypeKind::Int64:
+		return integer(true);
+	case TypeKind::Enum:
+		return integer(is_signed_enum(type));
+	case TypeKind::UInt8:
+	case TypeKind::UInt16:
+	case TypeKind::UInt32:
+	case TypeKind::UInt64:
+	case TypeKind::Bitfield:
+	case TypeKind::Pointer: // pointers of the target process
+		return integer(false);
+	case TypeKind::Bool:
+		return size == 1 ? "bool" : std::string_view{};
+	case TypeKind::Float:
+		return size == 4 ? "float" : std::string_view{};
+	case TypeKind::Double:
+		return size == 8 ? "double" : std::string_view{};
+	default:
+		return {};
+	}
+}
+
+namespace {
+
+struct Field
+{
+	std::string name;
+	std::size_t offset;
+	std::size_t size;
+	const AbstractType *type;
+	TypeKind kind;
+};
+
+struct Struct
+{
+	std::string name;
+	std::size_t type_size;
+	std::vector<Field> fields;
+};
+
+} // namespace
+
+static void write_struct(std::ostream &out, Struct &s)
+{
+	std::ranges::stable_sort(s.fields, {}, &Field::offset);
+	std::vector<const Field *> members;
+	out << std::format("struct {}\n{{\n", s.name);
+	out << std::format("\tstatic constexpr std::size_t type_size = {};\n\n", hex_value{s.type_size});
+	// several entries may give the same identifier
+	std::set<std::string> names;
+	for (auto &field: s.fields) {
+		auto name = field.name;
+		for (int i = 2; names.contains(name); ++i)
+			name = std::format("{}_{}", field.name, i);
+		field.name = *names.insert(std::move(name)).first;
+	}
+	std::size_t end = 0;
+	for (const auto &field: s.fields) {
+		if (field.size == 0) {
+			out << std::format("\t// {} at {} has no size\n",
+					field.name, hex_value{field.offset});
+			continue;
+		}
+		if (field.offset < end) {
+			out << std::format("\t// {} at {} overlaps the previous member\n",
+					field.name, hex_value{field.offset});
+			continue;
+		}
+		if (field.offset > end)
+			out << std::format("\tstd::byte _pad_{:x}[{}];\n", end, hex_value{field.offset - end});
+		if (auto type = field_type(*field.type, field.kind, field.size); !type.empty())
+			out << std::format("\t{} {};", type, field.name);
+		else
+			out << std::format("\tstd::byte {}[{}];", field.name, hex_value{field.size});
+		out << std::format(" // {}\n", kind_name(field.kind));
+		members.push_back(&field);
+		end = field.offset + field.size;
+	}
+	out << "};\n";
+	for (auto field: members)
+		out << std::format("static_assert(offsetof({}, {}) == {});\n",
+				s.name, field->name, hex_value{field->offset});
+	out << std::format("static_assert(sizeof({0}) <= {0}::type_size);\n\n", s.name);
+}
+
+void write_cpp_header(std::ostream &out,
+		      const Generator &generator,
+		      const LayoutDescription &description,
+		      std::vector<std::string> &errors)
+{
+	out << std::format("// Generated by dt-memory-layout for {}\n", generator.version().version_name);
+	out << "#pragma once\n\n";
+	out << "#include <cstddef>\n";
+	out << "#include <cstdint>\n\n";
+	out << "#pragma pack(push, 1)\n\n";
+
+	for (auto section: description.root().children("section")) {
+		std::string_view section_name = section.attribute("name").value();
+		// Structs in order of first appearance in the section
+		std::vector<Struct> structs;
+		std::map<std::string_view, std::size_t> struct_index;
+		for (auto entry: section.children("offset")) {
+			std::string_view type_name = entry.attribute("type").value();
+			std::string_view entry_name = entry.attribute("name").value();
+			try {
+				const auto &type = generator.compound(type_name);
+				auto m = generator.member(type, entry.attribute("member").value());
+				auto [it, inserted] = struct_index.try_emplace(type_name, structs.size());
+				if (inserted)
+					structs.push_back({
+						std::format("{}_{}", identifier(section_name), identifier(type_name)),
+						generator.size(type),
+						{}});
+				structs[it->second].fields.push_back({
+						identifier(entry_name),
+						m.offset,
+						m.size,
+						m.type,
+						type_kind(*m.type, m.size)});
+			}
+			catch (std::exception &e) {
+				errors.push_back(std::format("offset {}: {}.", entry_name, e.what()));
+			}
+		}
+		for (auto &s: structs)
+			write_struct(out, s);
+	}
+	out << "#pragma pack(pop)\n";
+}
+
+} // namespace dtml
@@ -0,0 +1,46 @@
+/*
+ * Copyright 2023 Clement Vuchener
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+#ifndef DTML_CPP_HEADER_H
+#define DTML_CPP_HEADER_H
+
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "Generator.h"
+
+namespace dtml {
+
+// Write a C++ header with one packed struct per section and type, holding
+// the members of the offset entries at their offsets (--cpp-header).
+//
+// Structs are named "<section>_<type>" and stop after their last member,
+// type_size gives the full size of the type in this version. Members
+// overlapping a previous one (unions, duplicated entries) are left out
+// with a comment, as are members without size. Identifiers colliding with
+// C++ keywords or the generated names get a trailing underscore, and
+// duplicates a numeric suffix. Entries that cannot be evaluated add an
+// error message to errors.
+void write_cpp_header(std::ostream &out,
+		      const Generator &generator,
+		      const LayoutDescription &description,
+		      std::vector<std::string> &errors);
+
+} // namespace dtml
+
+#endif
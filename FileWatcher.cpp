@@ -0,0 +1,100 @@
+/*
+ * Copyright 2023 Clement Vuchener
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "FileWatcher.h"
+
+#include <cerrno>
+#include <format>
+#include <system_error>
+
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+
+namespace fs = std::filesystem;
+
+static constexpr std::uint32_t WatchMask =
+	IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE | IN_DELETE | IN_MOVED_FROM;
+
+FileWatcher::FileWatcher():
+	_fd(inotify_init1(IN_CLOEXEC))
+{
+	if (_fd == -1)
+		throw std::system_error(errno, std::generic_category(), "inotify_init1");
+}
+
+FileWatcher::~FileWatcher()
+{
+	close(_fd);
+}
+
+fs::path FileWatcher::addDirectory(const fs::path &directory)
+{
+	int wd = inotify_add_watch(_fd, directory.c_str(), WatchMask);
+	if (wd == -1)
+		throw std::system_error(errno, std::generic_category(),
+				std::format("inotify_add_watch {}", directory.string()));
+	// "dir/" would not compare equal to the parent path of "dir/file"
+	auto normalized = directory.lexically_normal();
+	if (!normalized.has_filename() && normalized.has_relative_path())
+		normalized = normalized.parent_path();
+	_directories.insert_or_assign(wd, normalized);
+	return normalized;
+}
+
+bool FileWatcher::readEvents(std::set<fs::path> &changed, int timeout_ms)
+{
+	pollfd pfd = {_fd, POLLIN, 0};
+	int ret = poll(&pfd, 1, timeout_ms);
+	if (ret == -1) {
+		if (errno == EINTR)
+			return false;
+		throw std::system_error(errno, std::generic_category(), "poll");
+	}
+	if (ret == 0)
+		return false;
+
+	alignas(inotify_event) char buffer[4096];
+	ssize_t len = read(_fd, buffer, sizeof(buffer));
+	if (len == -1) {
+		if (errno == EINTR || errno == EAGAIN)
+			return false;
+		throw std::system_error(errno, std::generic_category(), "read inotify events");
+	}
+	for (char *ptr = buffer; ptr < buffer + len; ) {
+		auto event = reinterpret_cast<const inotify_event *>(ptr);
+		ptr += sizeof(inotify_event) + event->len;
+		if (event->len == 0 || (event->mask & IN_ISDIR))
+			continue;
+		auto dir = _directories.find(event->wd);
+		if (dir == _directories.end())
+			continue;
+		changed.insert(dir->second / event->name);
+	}
+	return true;
+}
+
+std::set<fs::path> FileWatcher::wait(std::chrono::milliseconds settle)
+{
+	std::set<fs::path> changed;
+	while (changed.empty())
+		readEvents(changed, -1);
+	while (readEvents(changed, settle.count()))
+		;
+	return changed;
+}
@@ -0,0 +1,56 @@
+/*
+ * Copyright 2023 Clement Vuchener
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef FILE_WATCHER_H
+#define FILE_WATCHER_H
+
+#include <chrono>
+#include <filesystem>
+#include <map>
+#include <set>
+
+// Watch directories for modified files using inotify.
+//
+// Directories are watched instead of files because editors and git
+// usually replace files instead of modifying them in place.
+class FileWatcher
+{
+public:
+	FileWatcher();
+	~FileWatcher();
+
+	FileWatcher(const FileWatcher &) = delete;
+	FileWatcher &operator=(const FileWatcher &) = delete;
+
+	// Returns the normalized directory path (without trailing
+	// separator) used as the parent of the paths returned by wait.
+	std::filesystem::path addDirectory(const std::filesystem::path &directory);
+
+	// Block until some files are modified, then keep collecting events
+	// until none is received for the settle delay. Returns the modified
+	// file paths.
+	std::set<std::filesystem::path> wait(std::chrono::milliseconds settle = std::chrono::milliseconds(100));
+
+private:
+	bool readEvents(std::set<std::filesystem::path> &changed, int timeout_ms);
+
+	int _fd;
+	std::map<int, std::filesystem::path> _directories;
+};
+
+#endif
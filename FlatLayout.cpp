@@ -0,0 +1,106 @@
+/*
+ * Copyright 2023 Clement Vuchener
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "FlatLayout.h"
+
+#include <algorithm>
+
+#include <dfs/Path.h>
+
+using namespace dfs;
+
+namespace dtml {
+
+// Members of an anonymous compound are accessed as members of its parent,
+// so lookup is the named compound used for getOffset while members_of may
+// be an anonymous compound inside it.
+static void flatten(const MemoryLayout &layout, std::size_t pointer_size,
+		    const Compound &lookup, const Compound &members_of,
+		    std::size_t base, const std::string &prefix,
+		    bool recursive, std::vector<FlatMember> &members);
+
+// Members inherited from the parent chain come first, the base class is at
+// the start of the object (df-structures only uses single inheritance).
+// When the compound or a derived one has virtual methods, the vtable
+// pointer is listed at the start of the root of the chain.
+static void flatten_with_parents(const MemoryLayout &layout, std::size_t pointer_size,
+				 const Compound &compound,
+				 std::size_t base, const std::string &prefix,
+				 bool recursive, std::vector<FlatMember> &members,
+				 bool polymorphic = false)
+{
+	polymorphic = polymorphic || has_virtual_methods(compound);
+	if (auto parent = compound_parent(compound)) {
+		flatten_with_parents(layout, pointer_size, *parent, base, prefix, recursive, members, polymorphic);
+		flatten(layout, pointer_size, compound, compound, base, prefix, recursive, members);
+		return;
+	}
+	if (polymorphic)
+		members.push_back({prefix + VTableMember, base, pointer_size, nullptr, TypeKind::Pointer});
+	flatten(layout, pointer_size, compound, compound, base, prefix, recursive, members);
+}
+
+static void flatten(const MemoryLayout &layout, std::size_t pointer_size,
+		    const Compound &lookup, const Compound &members_of,
+		    std::size_t base, const std::string &prefix,
+		    bool recursive, std::vector<FlatMember> &members)
+{
+	for (const auto &member: members_of.members) {
+		if (member.name.empty()) {
+			if (auto anonymous = dynamic_cast<const Compound *>(&member.type.get()))
+				flatten(layout, pointer_size, lookup, *anonymous, base, prefix, recursive, members);
+			continue;
+		}
+		auto [type, offset] = layout.getOffset(lookup, parse_path(member.name));
+		auto size = type_size(layout, *type);
+		auto &flat = members.emplace_back(prefix + member.name, base + offset, size, type, type_kind(*type, size));
+		if (!recursive)
+			continue;
+		if (auto compound = dynamic_cast<const Compound *>(type)) {
+			auto path = flat.path + ".";
+			flatten_with_parents(layout, pointer_size, *compound, base + offset, path, true, members);
+		}
+	}
+}
+
+std::vector<FlatMember> flatten_compound(const MemoryLayout &layout, std::size_t pointer_size, const Compound &compound)
+{
+	std::vector<FlatMember> members;
+	flatten_with_parents(layout, pointer_size, compound, 0, {}, true, members);
+	return members;
+}
+
+std::vector<FlatMember> direct_members(const MemoryLayout &layout, std::size_t pointer_size, const Compound &compound)
+{
+	std::vector<FlatMember> members;
+	flatten_with_parents(layout, pointer_size, compound, 0, {}, false, members);
+	return members;
+}
+
+std::vector<const Compound *> all_compounds(const MemoryLayout &layout)
+{
+	std::vector<const Compound *> compounds;
+	for (const auto &[type, info]: layout.type_info) {
+		if (auto compound = dynamic_cast<const Compound *>(type))
+			compounds.push_back(compound);
+	}
+	std::ranges::sort(compounds, {}, [](const Compound *c) { return type_name(*c); });
+	return compounds;
+}
+
+} // namespace dtml
@@ -0,0 +1,66 @@
+/*
+ * Copyright 2023 Clement Vuchener
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef DTML_FLAT_LAYOUT_H
+#define DTML_FLAT_LAYOUT_H
+
+#include <string>
+#include <vector>
+
+#include <dfs/MemoryLayout.h>
+
+#include "TypeInspection.h"
+
+namespace dtml {
+
+// Path of the vtable pointer pseudo-member
+inline constexpr char VTableMember[] = "(vtable)";
+
+struct FlatMember
+{
+	std::string path;	// dotted member path from the compound
+	std::size_t offset;	// from the start of the compound
+	std::size_t size;
+	const dfs::AbstractType *type;	// nullptr for the vtable pointer
+	TypeKind kind;
+};
+
+// List every member of a compound, recursing into nested compounds (the
+// nested compound itself is listed before its members). Members inherited
+// from parent compounds are listed first, after the vtable pointer of
+// polymorphic compounds (see VTableMember). Static arrays, containers and
+// pointers are listed as single members.
+//
+// Members are ordered by declaration, so offsets are not sorted in unions.
+// pointer_size is the size of the vtable pointer.
+std::vector<FlatMember> flatten_compound(const dfs::MemoryLayout &layout,
+					 std::size_t pointer_size,
+					 const dfs::Compound &compound);
+
+// Members declared directly in the compound (or in its anonymous members)
+// and its parents, without recursion into nested compounds.
+std::vector<FlatMember> direct_members(const dfs::MemoryLayout &layout,
+				       std::size_t pointer_size,
+				       const dfs::Compound &compound);
+
+// All compounds with a known layout, sorted by name
+std::vector<const dfs::Compound *> all_compounds(const dfs::MemoryLayout &layout);
+
+} // namespace dtml
+
+#endif
@@ -0,0 +1,624 @@
+/*
+ * Copyright 2023 Clement Vuchener
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "Generator.h"
+#include "ContainerLayout.h"
+#include "TypeInspection.h"
+
+#include <algorithm>
+#include <bit>
+#include <charconv>
+#include <iterator>
+#include <map>
+#include <optional>
+#include <format>
+#include <ostream>
+#include <ranges>
+#include <set>
+#include <stdexcept>
+#include <tuple>
+
+#include <dfs/Path.h>
+#include <dfs/Pointer.h>
+
+using namespace dfs;
+using namespace pugi;
+
+namespace dtml {
+
+LayoutDescription::LayoutDescription(const std::filesystem::path &path):
+	_file(path, MappedFile::Private)
+{
+	// Parse in place: strings point into the private mapping of the file
+	auto res = _doc.load_buffer_inplace(_file.data(), _file.size());
+	if (!res)
+		throw std::runtime_error(std::format("Failed to parse memory layout xml: {}", res.description()));
+}
+
+xml_node LayoutDescription::findEntry(std::string_view section, std::string_view name) const
+{
+	for (auto element: root().children()) {
+		if (element.type() != node_element || element.attribute("name").value() != section)
+			continue;
+		for (auto child: element.children()) {
+			if (child.type() == node_element && child.attribute("name").value() == name)
+				return child;
+		}
+	}
+	return {};
+}
+
+Generator::Generator(const Structures &structures,
+		     const Structures::VersionInfo &version,
+		     const ABI &abi,
+		     const MemoryLayout &layout):
+	_structures(structures),
+	_version(version),
+	_abi(abi),
+	_layout(layout)
+{
+}
+
+const Compound &Generator::compound(std::string_view type) const
+{
+	auto compound = _structures.findCompound(parse_path(type));
+	if (!compound)
+		throw std::runtime_error(std::format("type {} not found", type));
+	return *compound;
+}
+
+std::size_t Generator::offset(const Compound &type, std::string_view member) const
+{
+	try {
+		auto [member_type, offset] = _layout.getOffset(type, parse_path(member));
+		return offset;
+	}
+	catch (std::exception &e) {
+		throw std::runtime_error(std::format("failed to get member {} offset: {}", member, e.what()));
+	}
+}
+
+Generator::Member Generator::member(const Compound &type, std::string_view member) const
+{
+	try {
+		auto [member_type, offset] = _layout.getOffset(type, parse_path(member));
+		return {member_type, offset, type_size(_layout, *member_type)};
+	}
+	catch (std::exception &e) {
+		throw std::runtime_error(std::format("failed to get member {}: {}", member, e.what()));
+	}
+}
+
+std::size_t Generator::size(const Compound &type) const
+{
+	auto it = _layout.type_info.find(&type);
+	if (it == _layout.type_info.end())
+		throw std::runtime_error("missing type info");
+	return it->second.size;
+}
+
+std::size_t Generator::vmethod(const Compound &type, std::string_view method) const
+{
+	auto vtable_index = type.methodIndex(method);
+	if (vtable_index == -1)
+		throw std::runtime_error(std::format("method {} not found", method));
+	return vtable_index * _abi.pointer.size;
+}
+
+std::size_t Generator::enumValue(std::string_view enum_name, std::string_view value) const
+{
+	auto enum_type = _structures.findEnum(enum_name);
+	if (!enum_type)
+		throw std::runtime_error(std::format("unknown enum {}", enum_name));
+	auto value_it = enum_type->values.find(value);
+	if (value_it == enum_type->values.end())
+		throw std::runtime_error(std::format("unknown enum value {} in {}", value, enum_name));
+	return value_it->second.value;
+}
+
+std::size_t Generator::global(std::string_view object) const
+{
+	try {
+		return Pointer::fromGlobal(_structures, _version, _layout, parse_path(object)).address;
+	}
+	catch (std::exception &e) {
+		throw std::runtime_error(std::format("global object {}: {}", object, e.what()));
+	}
+}
+
+const AbstractType &Generator::globalType(std::string_view object) const
+{
+	try {
+		auto type = Pointer::fromGlobal(_structures, _version, _layout, parse_path(object)).type;
+		if (!type)
+			throw std::runtime_error("unknown type");
+		return *type;
+	}
+	catch (std::exception &e) {
+		throw std::runtime_error(std::format("global object {}: {}", object, e.what()));
+	}
+}
+
+Generator::PointerChain Generator::pointerChain(std::string_view object) const
+{
+	try {
+		auto path = parse_path(object);
+		if (path.empty())
+			throw std::runtime_error("empty path");
+		auto root = Pointer::fromGlobal(_structures, _version, _layout, Path(path.begin(), path.begin() + 1));
+		PointerChain chain = {root.address, {}};
+		const AbstractType *type = root.type;
+		auto current = [&chain]() -> std::size_t & {
+			return chain.offsets.empty() ? chain.base : chain.offsets.back();
+		};
+		auto add_index = [&](int index, const AbstractType &item_type) {
+			if (index < 0)
+				throw std::runtime_error(std::format("invalid index {}", index));
+			current() += static_cast<std::size_t>(index) * type_size(_layout, item_type);
+			type = &item_type;
+		};
+		for (const auto &item: std::span(path).subspan(1)) {
+			if (!type)
+				throw std::runtime_error("unknown type");
+			auto index = std::get_if<int>(&item);
+			if (auto pointer = dynamic_cast<const PointerType *>(type)) {
+				type = pointed_type(*pointer);
+				if (!type)
+					throw std::runtime_error(std::format("cannot dereference an untyped pointer before {}",
+							index ? std::format("[{}]", *index) : std::get<std::string>(item)));
+				chain.offsets.push_back(0);
+				// an index in a pointer to an array selects an item
+				if (index && pointer->is_array) {
+					add_index(*index, *type);
+					continue;
+				}
+			}
+			if (index) {
+				auto item_type = array_item_type(*type);
+				if (!item_type)
+					throw std::runtime_error(std::format("{} is not an array", type_name(*type)));
+				add_index(*index, *item_type);
+			}
+			else {
+				auto compound = dynamic_cast<const Compound *>(type);
+				if (!compound)
+					throw std::runtime_error(std::format("{} is not a compound", type_name(*type)));
+				auto [member_type, offset] = _layout.getOffset(*compound, Path{item});
+				current() += offset;
+				type = member_type;
+			}
+		}
+		return chain;
+	}
+	catch (std::exception &e) {
+		throw std::runtime_error(std::format("global object {}: {}", object, e.what()));
+	}
+}
+
+std::size_t Generator::vtable(std::string_view type) const
+{
+	auto it = _version.vtables_addresses.find(type);
+	if (it == _version.vtables_addresses.end())
+		throw std::runtime_error(std::format("failed to find vtable for {}", type));
+	return it->second;
+}
+
+Generator::FlagMask Generator::flags(std::string_view bitfield_name, std::string_view flags) const
+{
+	auto bitfield = _structures.findBitfield(bitfield_name);
+	if (!bitfield)
+		throw std::runtime_error(std::format("unknown bitfield {}", bitfield_name));
+	// Bitfields up to 64 bits are a single word, larger ones are read as
+	// 32-bit words
+	unsigned int word_bits = 32;
+	if (auto it = _layout.type_info.find(bitfield); it != _layout.type_info.end() && it->second.size <= 8)
+		word_bits = 8 * it->second.size;
+
+	std::optional<FlagMask> result;
+	for (auto flag_range: flags | std::views::split('|')) {
+		auto flag = std::string_view(std::begin(flag_range), std::end(flag_range));
+		auto flag_name = flag.substr(0, flag.find('='));
+		auto flag_it = std::ranges::find(bitfield->flags, flag_name, &Bitfield::Flag::name);
+		if (flag_it == bitfield->flags.end())
+			throw std::runtime_error(std::format("unknown flag value {} in {}", flag_name, bitfield_name));
+		unsigned int word = flag_it->offset / word_bits;
+		unsigned int bit = flag_it->offset % word_bits;
+		if (flag_it->count < 1 || bit + flag_it->count > word_bits)
+			throw std::runtime_error(std::format("flag {} does not fit in a {}-bit word", flag_name, word_bits));
+		std::uint64_t field_mask = flag_it->count == 64 ? ~std::uint64_t(0) : (std::uint64_t(1) << flag_it->count) - 1;
+
+		std::uint64_t value = 1;
+		if (flag_name.size() < flag.size()) {
+			auto value_str = flag.substr(flag_name.size() + 1);
+			int base = 10;
+			auto digits = value_str;
+			if (digits.starts_with("0x")) {
+				base = 16;
+				digits.remove_prefix(2);
+			}
+			auto [end, ec] = std::from_chars(digits.data(), digits.data() + digits.size(), value, base);
+			if (digits.empty() || ec != std::errc{} || end != digits.data() + digits.size())
+				throw std::runtime_error(std::format("invalid value {} for flag {}", value_str, flag_name));
+			if (value & ~field_mask)
+				throw std::runtime_error(std::format("value {} does not fit in the {} bits of {}", value, flag_it->count, flag_name));
+		}
+		else if (flag_it->count != 1)
+			throw std::runtime_error(std::format("{} is a multi-bit flag, use {}=VALUE", flag_name, flag_name));
+
+		if (!result)
+			result = FlagMask{word, 0, 0};
+		else if (result->word != word)
+			throw std::runtime_error(std::format("flag {} is not in the same word as the previous flags", flag_name));
+		result->mask |= field_mask << bit;
+		result->value |= value << bit;
+	}
+	if (!result)
+		throw std::runtime_error("no flag");
+	return *result;
+}
+
+std::size_t Generator::evaluateEntry(xml_node entry) const
+{
+	std::string_view name = entry.name();
+	if (name == "flag")
+		return flags(entry.parent().attribute("bitfield").value(), entry.attribute("flags").value()).mask;
+
+	const Compound *type = nullptr;
+	if (auto type_attr = entry.attribute("type"))
+		type = &compound(type_attr.value());
+	auto need_type = [&]() -> const Compound & {
+		if (!type)
+			throw std::runtime_error("need a type");
+		return *type;
+	};
+
+	if (name == "offset")
+		return offset(need_type(), entry.attribute("member").value());
+	else if (name == "size")
+		return size(need_type());
+	else if (name == "vmethod")
+		return vmethod(need_type(), entry.attribute("method").value());
+	else if (name == "value") {
+		if (auto enum_name = entry.attribute("enum"))
+			return enumValue(enum_name.value(), entry.attribute("value").value());
+		else
+			return entry.attribute("value").as_int();
+	}
+	else if (name == "global")
+		return global(entry.attribute("object").value());
+	else if (name == "vtable")
+		return vtable(entry.attribute("type").value());
+	else
+		throw std::runtime_error("invalid tag name");
+}
+
+void Generator::evaluateSection(xml_node element, Section &section, std::vector<std::string> &errors) const
+{
+	for (auto child: element.children()) {
+		if (child.type() != node_element)
+			continue;
+		std::string_view name = child.name();
+		std::string_view entry_name = child.attribute("name").value();
+		try {
+			section.entries.push_back({std::string(entry_name), evaluateEntry(child)});
+		}
+		catch (std::exception &e) {
+			errors.push_back(std::format("{} {}: {}.", name, entry_name, e.what()));
+		}
+	}
+}
+
+void Generator::evaluateFlagArray(xml_node element, Section &section, std::vector<std::string> &errors) const
+{
+	std::string_view bitfield_name = element.attribute("bitfield").value();
+	if (!_structures.findBitfield(bitfield_name)) {
+		errors.push_back(std::format("Unknown bitfield {}.", bitfield_name));
+		return;
+	}
+
+	for (auto child: element.children()) {
+		if (child.type() != node_element)
+			continue;
+		std::string_view name = child.name();
+		if (name != "flag") {
+			errors.push_back(std::format("invalid tagname {} in flag-array.", name));
+			continue;
+		}
+		std::string_view entry_name = child.attribute("name").value();
+		try {
+			auto [word, mask, value] = flags(bitfield_name, child.attribute("flags").value());
+			auto &entry = section.entries.emplace_back(std::string(entry_name), mask);
+			entry.word = word;
+			entry.expected = value;
+		}
+		catch (std::exception &e) {
+			errors.push_back(std::format("flag {}: {}.", entry_name, e.what()));
+		}
+	}
+}
+
+std::vector<Generator::OffsetMember> Generator::offsetMembers(xml_node element, const Section &section, std::vector<std::string> &errors) const
+{
+	std::vector<OffsetMember> members;
+	for (auto child: element.children("offset")) {
+		std::string_view type = child.attribute("type").value();
+		std::string_view entry_name = child.attribute("name").value();
+		try {
+			auto m = member(compound(type), child.attribute("member").value());
+			members.push_back({type, entry_name, m});
+		}
+		catch (std::exception &e) {
+			// Entries without an offset already have an error
+			if (std::ranges::find(section.entries, entry_name, &Entry::name) != section.entries.end())
+				errors.push_back(std::format("offset {}: {}.", entry_name, e.what()));
+		}
+	}
+	return members;
+}
+
+Section Generator::readPlan(std::string_view section_name, std::span<const OffsetMember> members)
+{
+	struct Range
+	{
+		std::string_view type;
+		std::size_t start, end;
+	};
+	std::vector<Range> ranges;
+	for (const auto &[type, entry_name, m]: members)
+		ranges.push_back({type, m.offset, m.offset + m.size});
+	std::ranges::sort(ranges, {}, [](const Range &r) { return std::tie(r.type, r.start); });
+
+	Section plan = {Section::Kind::ReadPlan, std::format("{}_read_plan", section_name), {}};
+	for (auto it = ranges.begin(); it != ranges.end();) {
+		auto [type, start, end] = *it;
+		// Merge overlapping and adjacent ranges
+		for (++it; it != ranges.end() && it->type == type && it->start <= end; ++it)
+			end = std::max(end, it->end);
+		plan.entries.push_back({std::string(type), start, end - start});
+	}
+	return plan;
+}
+
+Section Generator::memberTypes(std::string_view section_name, std::span<const OffsetMember> members)
+{
+	Section types = {Section::Kind::Types, std::format("{}_types", section_name), {}};
+	for (const auto &[type, entry_name, m]: members) {
+		auto &entry = types.entries.emplace_back(std::string(entry_name), m.size);
+		entry.kind = type_kind(*m.type, m.size);
+	}
+	return types;
+}
+
+Section Generator::pointerChains(xml_node element, const Section &section, std::vector<std::string> &errors) const
+{
+	Section chains = {Section::Kind::Values, std::format("{}_chains", section.name), {}};
+	for (auto child: element.children("global")) {
+		std::string_view entry_name = child.attribute("name").value();
+		try {
+			auto [base, offsets] = pointerChain(child.attribute("object").value());
+			chains.entries.push_back({std::format("{}\\base", entry_name), base});
+			chains.entries.push_back({std::format("{}\\steps", entry_name), offsets.size()});
+			for (unsigned int i = 0; i < offsets.size(); ++i)
+				chains.entries.push_back({std::format("{}\\{}\\offset", entry_name, i+1), offsets[i]});
+		}
+		catch (std::exception &e) {
+			// Entries without an address already have an error
+			if (std::ranges::find(section.entries, entry_name, &Entry::name) != section.entries.end())
+				errors.push_back(std::format("global {} chain: {}.", entry_name, e.what()));
+		}
+	}
+	return chains;
+}
+
+Section Generator::strides(xml_node element, const Section &section, std::span<const OffsetMember> members, std::vector<std::string> &errors) const
+{
+	Section strides = {Section::Kind::Values, std::format("{}_strides", section.name), {}};
+	auto add_stride = [&, this](std::string_view entry_name, const AbstractType &type) {
+		auto item = vector_item_type(type);
+		if (!item)
+			return;
+		bool pointers = dynamic_cast<const PointerType *>(item);
+		auto stride = pointers ? _abi.pointer.size : type_size(_layout, *item);
+		strides.entries.push_back({std::format("{}\\stride", entry_name), stride});
+		strides.entries.push_back({std::format("{}\\pointers", entry_name), pointers});
+	};
+	for (auto child: element.children()) {
+		std::string_view name = child.name();
+		std::string_view entry_name = child.attribute("name").value();
+		// Entries without a value already have an error
+		if (std::ranges::find(section.entries, entry_name, &Entry::name) == section.entries.end())
+			continue;
+		try {
+			if (name == "global")
+				add_stride(entry_name, globalType(child.attribute("object").value()));
+			else if (name == "offset") {
+				auto member = std::ranges::find(members, entry_name, &OffsetMember::entry_name);
+				if (member != members.end())
+					add_stride(entry_name, *member->member.type);
+			}
+		}
+		catch (std::exception &e) {
+			errors.push_back(std::format("{} {} stride: {}.", name, entry_name, e.what()));
+		}
+	}
+	return strides;
+}
+
+Section Generator::extents(std::string_view section_name, std::span<const OffsetMember> members, std::vector<std::string> &errors) const
+{
+	// Types in order of first appearance
+	std::vector<std::pair<std::string_view, std::size_t>> type_extents;
+	for (const auto &[type, entry_name, m]: members) {
+		auto it = std::ranges::find(type_extents, type, &std::pair<std::string_view, std::size_t>::first);
+		if (it == type_extents.end())
+			type_extents.emplace_back(type, m.offset + m.size);
+		else
+			it->second = std::max(it->second, m.offset + m.size);
+	}
+	Section section = {Section::Kind::Values, std::format("{}_extents", section_name), {}};
+	for (auto [type, extent]: type_extents) {
+		try {
+			auto type_size = size(compound(type));
+			section.entries.push_back({std::format("{}\\extent", type), extent});
+			section.entries.push_back({std::format("{}\\size", type), type_size});
+		}
+		catch (std::exception &e) {
+			errors.push_back(std::format("extent of {}: {}.", type, e.what()));
+		}
+	}
+	return section;
+}
+
+std::vector<Section> Generator::optionalSections(xml_node element, const Section &section, const GenerateOptions &options, std::vector<std::string> &errors) const
+{
+	std::vector<Section> sections;
+	bool has_offsets = !element.child("offset").empty();
+	std::vector<OffsetMember> members;
+	if ((options.read_plans || options.typed || options.strides || options.extents) && has_offsets)
+		members = offsetMembers(element, section, errors);
+	if (options.read_plans && has_offsets)
+		sections.push_back(readPlan(section.name, members));
+	if (options.typed && has_offsets)
+		sections.push_back(memberTypes(section.name, members));
+	if (options.extents && has_offsets)
+		sections.push_back(extents(section.name, members, errors));
+	if (options.pointer_chains && !element.child("global").empty())
+		sections.push_back(pointerChains(element, section, errors));
+	if (options.strides) {
+		auto section_strides = strides(element, section, members, errors);
+		if (!section_strides.entries.empty())
+			sections.push_back(std::move(section_strides));
+	}
+	return sections;
+}
+
+void Generator::evaluateEnumTable(xml_node element, Section &section, std::vector<std::string> &errors) const
+{
+	// Tables larger than this are probably not meant to be dense
+	constexpr long long MaxTableSize = 1 << 16;
+
+	std::string_view enum_name = element.attribute("enum").value();
+	auto enum_type = _structures.findEnum(enum_name);
+	if (!enum_type) {
+		errors.push_back(std::format("Unknown enum {}.", enum_name));
+		return;
+	}
+	if (enum_type->values.empty())
+		return;
+	auto [min, max] = std::ranges::minmax(enum_type->values | std::views::values, {}, &Enum::Value::value);
+	long long first = min.value, last = max.value;
+	if (last - first >= MaxTableSize) {
+		errors.push_back(std::format("enum-table {}: values of {} span more than {} items.",
+				section.name, enum_name, MaxTableSize));
+		return;
+	}
+	for (long long value = first; value <= last; ++value)
+		section.entries.push_back({{}, static_cast<std::size_t>(value)});
+	for (const auto &[name, value]: enum_type->values) {
+		// The structures do not keep the declaration order of enum
+		// items, aliased values get the smallest name so that the
+		// table does not depend on the iteration order.
+		auto &entry = section.entries[value.value - first];
+		if (entry.name.empty() || name < entry.name)
+			entry.name = name;
+	}
+}
+
+GeneratedLayout Generator::generate(const LayoutDescription &description,
+				    const GenerateOptions &options) const
+{
+	GeneratedLayout result;
+	result.version_name = _version.version_name;
+	if (_version.id.size() < 4) {
+		result.errors.push_back(std::format("Invalid version id, size is too small: {}", _version.id.size()));
+		return result;
+	}
+	result.checksum = std::uint32_t(_version.id[0]) << 24
+			| std::uint32_t(_version.id[1]) << 16
+			| std::uint32_t(_version.id[2]) << 8
+			| std::uint32_t(_version.id[3]);
+
+	Section flag_masks = {Section::Kind::Values, "flag_masks", {}};
+
+	if (options.abi_section) {
+		try {
+			result.sections.push_back(container_layout_section("abi",
+					container_layout(_abi)));
+		}
+		catch (std::exception &e) {
+			result.errors.push_back(std::format("abi: {}.", e.what()));
+		}
+	}
+
+	for (auto element: description.root().children()) {
+		if (element.type() != node_element)
+			continue;
+		std::string_view name = element.name();
+		if (name == "section") {
+			Section section = {Section::Kind::Values, element.attribute("name").value(), {}};
+			evaluateSection(element, section, result.errors);
+			auto extra = optionalSections(element, section, options, result.errors);
+			result.sections.push_back(std::move(section));
+			std::ranges::move(extra, std::back_inserter(result.sections));
+		}
+		else if (name == "flag-array") {
+			auto &section = result.sections.emplace_back(Section::Kind::FlagArray, element.attribute("name").value());
+			evaluateFlagArray(element, section, result.errors);
+			if (options.flag_masks) {
+				// mask and expected value of each word
+				std::map<unsigned int, std::pair<std::size_t, std::size_t>> words;
+				std::set<unsigned int> conflicts, multi_bit;
+				for (const auto &entry: section.entries) {
+					// entries are tested on their own, several bits
+					// cannot be merged with the others
+					if (!std::has_single_bit(entry.value))
+						multi_bit.insert(entry.word);
+					auto &[mask, expected] = words[entry.word];
+					// flags sharing bits must expect the same value
+					if ((expected ^ entry.expected) & mask & entry.value)
+						conflicts.insert(entry.word);
+					mask |= entry.value;
+					expected |= entry.expected;
+				}
+				for (auto [word, masks]: words) {
+					auto name = std::format("{}\\{}", section.name, word);
+					if (multi_bit.contains(word)) {
+						result.warnings.push_back(std::format("flag_masks {}: skipped, some entries test several bits.", name));
+						continue;
+					}
+					flag_masks.entries.push_back({name, masks.first});
+					if (conflicts.contains(word))
+						result.warnings.push_back(std::format("flag_masks {}: no expected value, flags expect different values for the same bits.", name));
+					else
+						flag_masks.entries.push_back({name + "\\expected", masks.second});
+				}
+			}
+		}
+		else if (name == "enum-table") {
+			auto &section = result.sections.emplace_back(Section::Kind::EnumTable, element.attribute("name").value());
+			evaluateEnumTable(element, section, result.errors);
+		}
+		else
+			result.errors.push_back(std::format("Ignoring unknown tag name: {}", name));
+	}
+	if (!flag_masks.entries.empty())
+		result.sections.push_back(std::move(flag_masks));
+	return result;
+}
+
+} // namespace dtml
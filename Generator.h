@@ -0,0 +1,217 @@
+/*
+ * Copyright 2023 Clement Vuchener
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef DTML_GENERATOR_H
+#define DTML_GENERATOR_H
+
+#include <cstdint>
+#include <filesystem>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <dfs/Structures.h>
+#include <dfs/ABI.h>
+#include <dfs/MemoryLayout.h>
+
+#include <pugixml.hpp>
+
+#include "MappedFile.h"
+#include "TypeInspection.h"
+
+namespace dtml {
+
+// Parsed memory layout XML (the files from the ini directory)
+class LayoutDescription
+{
+public:
+	// Throws std::runtime_error if the file cannot be parsed
+	explicit LayoutDescription(const std::filesystem::path &path);
+
+	pugi::xml_node root() const { return _doc.document_element(); }
+
+	// Find the element for an entry, returns a null node if not found
+	pugi::xml_node findEntry(std::string_view section, std::string_view name) const;
+
+private:
+	MappedFile _file;
+	pugi::xml_document _doc;
+};
+
+struct Entry
+{
+	std::string name;
+	std::size_t value;
+	std::size_t length = 0;	// only used by read plans
+	TypeKind kind = TypeKind::Other;	// only used by type sections
+	// Only used by flag arrays: value is the mask of the flags in the
+	// bitfield word, they are set when (word & value) == expected
+	unsigned int word = 0;
+	std::size_t expected = 0;
+};
+
+struct Section
+{
+	enum class Kind {
+		Values,		// name=value pairs
+		FlagArray,	// array of named flag values
+		ReadPlan,	// byte ranges: name is the type, value the start, length the size
+		Types,		// offset member types: value is the size, and kind is set
+		EnumTable,	// consecutive enum values (unnamed in gaps), negative
+				// values are stored in two's complement
+	};
+	Kind kind;
+	std::string name;
+	std::vector<Entry> entries;
+};
+
+struct GeneratedLayout
+{
+	std::uint32_t checksum = 0;
+	std::string version_name;
+	std::vector<Section> sections;
+	// Entries that could not be evaluated are missing from their
+	// section and an error message is added here.
+	std::vector<std::string> errors;
+	// Problems with optional sections that do not make the layout wrong
+	std::vector<std::string> warnings;
+
+	bool ok() const { return errors.empty(); }
+};
+
+// Optional sections generated in addition to the layout description
+struct GenerateOptions
+{
+	// Add a "<section>_read_plan" section after each section with
+	// offsets, listing the merged byte ranges of their members per type,
+	// so that all the fields of an object can be read at once.
+	bool read_plans = false;
+	// Add a "<section>_types" section after each section with offsets,
+	// giving the size and kind of each member.
+	bool typed = false;
+	// Add an "abi" section first, with the pointer size and the internal
+	// layout of std::vector and std::string (see ContainerLayout.h).
+	bool abi_section = false;
+	// Add a "<section>_strides" section after each section with vector
+	// globals or offsets to vector members, giving the item size
+	// ("name\stride") and if the items are pointers ("name\pointers").
+	bool strides = false;
+	// Add a "flag_masks" section at the end, with the OR of the flags of
+	// each flag-array per bitfield word ("name\word") and the OR of their
+	// expected values ("name\word\expected"), so that a unit can be
+	// checked with one AND and compare per word. Words with entries
+	// testing several bits are skipped with a warning.
+	bool flag_masks = false;
+	// Add a "<section>_chains" section after each section with globals,
+	// giving their pointer chain: "name\base" and the offsets added
+	// after each dereference ("name\steps" and "name\N\offset").
+	bool pointer_chains = false;
+	// Add a "<section>_extents" section after each section with offsets,
+	// giving for each type the end of its last member used by the
+	// section ("type\extent") and its full size ("type\size").
+	bool extents = false;
+};
+
+// Evaluate memory layout entries for one version.
+//
+// The structures, ABI and memory layout must outlive the generator.
+class Generator
+{
+public:
+	Generator(const dfs::Structures &structures,
+		  const dfs::Structures::VersionInfo &version,
+		  const dfs::ABI &abi,
+		  const dfs::MemoryLayout &layout);
+
+	GeneratedLayout generate(const LayoutDescription &description,
+				 const GenerateOptions &options = {}) const;
+
+	// Evaluate an entry element from a layout description (including
+	// flags from a flag-array, whose value is their mask as in the
+	// generated section)
+	std::size_t evaluateEntry(pugi::xml_node entry) const;
+
+	// Single entry evaluation, all of them throw std::runtime_error when
+	// the entry cannot be evaluated.
+	const dfs::Compound &compound(std::string_view type) const;
+	std::size_t offset(const dfs::Compound &type, std::string_view member) const;
+	struct Member
+	{
+		const dfs::AbstractType *type;
+		std::size_t offset;
+		std::size_t size;
+	};
+	Member member(const dfs::Compound &type, std::string_view member) const;
+	std::size_t size(const dfs::Compound &type) const;
+	std::size_t vmethod(const dfs::Compound &type, std::string_view method) const;
+	std::size_t enumValue(std::string_view enum_name, std::string_view value) const;
+	std::size_t global(std::string_view object) const;
+	const dfs::AbstractType &globalType(std::string_view object) const;
+	// Address of a global object whose path may go through pointers:
+	// start from base, then for each offset, read the pointer at the
+	// current address and add the offset.
+	struct PointerChain
+	{
+		std::size_t base;
+		std::vector<std::size_t> offsets;
+	};
+	PointerChain pointerChain(std::string_view object) const;
+	std::size_t vtable(std::string_view type) const;
+	// flags are separated by '|', multi-bit flags are given with their
+	// value as "name=value", single-bit flags may use "name=0" to
+	// require them to be clear.
+	struct FlagMask
+	{
+		unsigned int word;	// index of the word in the bitfield
+		std::uint64_t mask;
+		std::uint64_t value;	// expected value of the masked word
+	};
+	FlagMask flags(std::string_view bitfield, std::string_view flags) const;
+
+	const dfs::Structures &structures() const { return _structures; }
+	const dfs::Structures::VersionInfo &version() const { return _version; }
+	const dfs::ABI &abi() const { return _abi; }
+	const dfs::MemoryLayout &layout() const { return _layout; }
+
+private:
+	void evaluateSection(pugi::xml_node element, Section &section, std::vector<std::string> &errors) const;
+	void evaluateFlagArray(pugi::xml_node element, Section &section, std::vector<std::string> &errors) const;
+	void evaluateEnumTable(pugi::xml_node element, Section &section, std::vector<std::string> &errors) const;
+	struct OffsetMember
+	{
+		std::string_view type_name, entry_name;
+		Member member;
+	};
+	std::vector<OffsetMember> offsetMembers(pugi::xml_node element, const Section &section, std::vector<std::string> &errors) const;
+	static Section readPlan(std::string_view section_name, std::span<const OffsetMember> members);
+	static Section memberTypes(std::string_view section_name, std::span<const OffsetMember> members);
+	Section extents(std::string_view section_name, std::span<const OffsetMember> members, std::vector<std::string> &errors) const;
+	std::vector<Section> optionalSections(pugi::xml_node element, const Section &section, const GenerateOptions &options, std::vector<std::string> &errors) const;
+	Section pointerChains(pugi::xml_node element, const Section &section, std::vector<std::string> &errors) const;
+	Section strides(pugi::xml_node element, const Section &section, std::span<const OffsetMember> members, std::vector<std::string> &errors) const;
+
+	const dfs::Structures &_structures;
+	const dfs::Structures::VersionInfo &_version;
+	const dfs::ABI &_abi;
+	const dfs::MemoryLayout &_layout;
+};
+
+} // namespace dtml
+
+#endif
@@ -0,0 +1,258 @@
+/*
+ * Copyright 2023 Clement Vuchener
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "GitRepository.h"
+#include "OutputFile.h"
+
+#include <cerrno>
+#include <csignal>
+#include <format>
+#include <stdexcept>
+#include <system_error>
+
+#include <fcntl.h>
+#include <spawn.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+extern char **environ;
+
+namespace fs = std::filesystem;
+
+namespace {
+
+// Spawn git with the given arguments, connecting the pipes that are not
+// null to its standard input and output.
+pid_t spawn_git(const fs::path &repository, std::vector<std::string> args, int *in_fd, int *out_fd)
+{
+	args.insert(args.begin(), {"git", "-C", repository.string()});
+	std::vector<char *> argv;
+	for (auto &arg: args)
+		argv.push_back(arg.data());
+	argv.push_back(nullptr);
+
+	// the pipes are close-on-exec, only the ends duplicated on the
+	// standard input or output are inherited by git
+	auto make_pipe = [](int fds[2]) {
+		if (pipe(fds) == -1)
+			throw std::system_error(errno, std::generic_category(), "pipe");
+		fcntl(fds[0], F_SETFD, FD_CLOEXEC);
+		fcntl(fds[1], F_SETFD, FD_CLOEXEC);
+	};
+	int in_pipe[2] = {-1, -1}, out_pipe[2] = {-1, -1};
+	if (in_fd)
+		make_pipe(in_pipe);
+	if (out_fd)
+		make_pipe(out_pipe);
+
+	posix_spawn_file_actions_t actions;
+	posix_spawn_file_actions_init(&actions);
+	if (in_fd)
+		posix_spawn_file_actions_adddup2(&actions, in_pipe[0], STDIN_FILENO);
+	if (out_fd)
+		posix_spawn_file_actions_adddup2(&actions, out_pipe[1], STDOUT_FILENO);
+	pid_t pid;
+	int err = posix_spawnp(&pid, "git", &actions, nullptr, argv.data(), environ);
+	posix_spawn_file_actions_destroy(&actions);
+	if (in_fd) {
+		close(in_pipe[0]);
+		*in_fd = in_pipe[1];
+	}
+	if (out_fd) {
+		close(out_pipe[1]);
+		*out_fd = out_pipe[0];
+	}
+	if (err != 0) {
+		if (in_fd)
+			close(*in_fd);
+		if (out_fd)
+			close(*out_fd);
+		throw std::system_error(err, std::generic_category(), "failed to run git");
+	}
+	return pid;
+}
+
+int wait_process(pid_t pid)
+{
+	int status;
+	while (waitpid(pid, &status, 0) == -1)
+		if (errno != EINTR)
+			return -1;
+	return WIFEXITED(status) ? WEXITSTATUS(status) : -1;
+}
+
+// Stop a child on error paths, without leaving a zombie
+void kill_process(pid_t pid)
+{
+	kill(pid, SIGKILL);
+	wait_process(pid);
+}
+
+} // namespace
+
+GitRepository::GitRepository(fs::path repository):
+	_path(std::move(repository))
+{
+	// A cat-file process dying makes writing requests fail with EPIPE
+	// instead of killing us, the error is then reported by read.
+	std::signal(SIGPIPE, SIG_IGN);
+
+	int in_fd, out_fd;
+	_pid = spawn_git(_path, {"cat-file", "--batch"}, &in_fd, &out_fd);
+	_in = fdopen(in_fd, "w");
+	_out = fdopen(out_fd, "r");
+	if (!_in || !_out) {
+		int err = errno;
+		if (_in)
+			fclose(_in);
+		else
+			close(in_fd);
+		if (_out)
+			fclose(_out);
+		else
+			close(out_fd);
+		kill_process(_pid);
+		throw std::system_error(err, std::generic_category(), "fdopen");
+	}
+}
+
+GitRepository::~GitRepository()
+{
+	// closing the input makes cat-file exit
+	fclose(_in);
+	fclose(_out);
+	wait_process(_pid);
+}
+
+GitRepository::Object GitRepository::read(std::string_view name)
+{
+	if (name.find('\n') != name.npos)
+		throw std::invalid_argument("invalid object name");
+	std::fprintf(_in, "%.*s\n", int(name.size()), name.data());
+	if (std::fflush(_in) != 0)
+		throw std::runtime_error("git cat-file exited unexpectedly");
+
+	// header: "<oid> <type> <size>" or "<name> missing"
+	char *line = nullptr;
+	std::size_t line_capacity = 0;
+	auto len = getline(&line, &line_capacity, _out);
+	if (len <= 0) {
+		std::free(line);
+		throw std::runtime_error("git cat-file exited unexpectedly");
+	}
+	std::string header(line, len - 1);
+	std::free(line);
+
+	auto first_space = header.find(' ');
+	auto second_space = header.find(' ', first_space + 1);
+	if (second_space == header.npos)
+		throw std::runtime_error(std::format("git object {} not found in {}", name, _path.string()));
+	Object object;
+	object.oid = header.substr(0, first_space);
+	object.type = header.substr(first_space + 1, second_space - first_space - 1);
+	auto size = std::stoull(header.substr(second_space + 1));
+	object.content.resize(size);
+	if (std::fread(object.content.data(), 1, size, _out) != size || std::fgetc(_out) != '\n')
+		throw std::runtime_error("truncated git cat-file output");
+	return object;
+}
+
+std::vector<GitRepository::TreeEntry> GitRepository::readTree(std::string_view treeish)
+{
+	auto tree = read(std::format("{}^{{tree}}", treeish));
+	// entries are "<mode> <name>\0<binary oid>", the oid length is the same
+	// as the tree's own id (sha1 or sha256)
+	std::size_t oid_size = tree.oid.size() / 2;
+	std::vector<TreeEntry> entries;
+	std::string_view data = tree.content;
+	while (!data.empty()) {
+		auto space = data.find(' ');
+		auto nul = data.find('\0', space);
+		if (space == data.npos || nul == data.npos || nul + 1 + oid_size > data.size())
+			throw std::runtime_error(std::format("invalid tree object {}", tree.oid));
+		TreeEntry entry;
+		entry.mode = data.substr(0, space);
+		entry.name = data.substr(space + 1, nul - space - 1);
+		for (auto c: data.substr(nul + 1, oid_size))
+			entry.oid += std::format("{:02x}", static_cast<unsigned char>(c));
+		entries.push_back(std::move(entry));
+		data.remove_prefix(nul + 1 + oid_size);
+	}
+	return entries;
+}
+
+std::vector<std::string> GitRepository::revList(const std::vector<std::string> &args) const
+{
+	std::vector<std::string> git_args = {"rev-list"};
+	git_args.insert(git_args.end(), args.begin(), args.end());
+	int out_fd;
+	pid_t pid = spawn_git(_path, git_args, nullptr, &out_fd);
+	std::vector<std::string> revs;
+	FILE *out = fdopen(out_fd, "r");
+	if (!out) {
+		int err = errno;
+		close(out_fd);
+		kill_process(pid);
+		throw std::system_error(err, std::generic_category(), "fdopen");
+	}
+	char *line = nullptr;
+	std::size_t line_capacity = 0;
+	ssize_t len;
+	while ((len = getline(&line, &line_capacity, out)) > 0)
+		revs.emplace_back(line, len - 1);
+	std::free(line);
+	fclose(out);
+	if (wait_process(pid) != 0)
+		throw std::runtime_error("git rev-list failed");
+	return revs;
+}
+
+fs::path GitRepository::extractXml(std::string_view rev, const fs::path &cache_root)
+{
+	auto tree = read(std::format("{}^{{tree}}", rev));
+	auto directory = cache_root / tree.oid;
+	if (fs::is_directory(directory))
+		return directory;
+
+	StagingDirectory staging(directory);
+	for (const auto &entry: readTree(tree.oid)) {
+		if (entry.mode.starts_with("100") && entry.name.ends_with(".xml"))
+			staging.writeFile(entry.name, read(entry.oid).content);
+	}
+	staging.commit();
+	return directory;
+}
+
+bool parse_git_source(std::string_view arg, fs::path &repository, std::string &rev)
+{
+	if (fs::is_directory(fs::path(arg)))
+		return false;
+	// revs may contain '@' too ("HEAD@{1}"), split at the first '@'
+	// that is not a reflog selector and follows an existing directory
+	for (auto at = arg.find('@'); at != arg.npos; at = arg.find('@', at + 1)) {
+		if (at == 0 || at + 1 == arg.size() || arg[at + 1] == '{')
+			continue;
+		fs::path repo(arg.substr(0, at));
+		if (!fs::is_directory(repo))
+			continue;
+		repository = std::move(repo);
+		rev = arg.substr(at + 1);
+		return true;
+	}
+	return false;
+}
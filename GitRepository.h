@@ -0,0 +1,83 @@
+/*
+ * Copyright 2023 Clement Vuchener
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef GIT_REPOSITORY_H
+#define GIT_REPOSITORY_H
+
+#include <cstdio>
+#include <filesystem>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <sys/types.h>
+
+// Read objects from a local git repository through a long-lived
+// "git cat-file --batch" process, without checking out anything.
+// Constructing a repository ignores SIGPIPE in the whole process.
+class GitRepository
+{
+public:
+	struct TreeEntry
+	{
+		std::string mode;
+		std::string name;
+		std::string oid;	// hexadecimal
+	};
+
+	struct Object
+	{
+		std::string oid;
+		std::string type;
+		std::string content;
+	};
+
+	explicit GitRepository(std::filesystem::path repository);
+	~GitRepository();
+
+	GitRepository(const GitRepository &) = delete;
+	GitRepository &operator=(const GitRepository &) = delete;
+
+	const std::filesystem::path &path() const { return _path; }
+
+	// Read any object by name (oid, ref, "rev^{tree}", ...), throws
+	// std::runtime_error if it does not exist.
+	Object read(std::string_view name);
+	std::vector<TreeEntry> readTree(std::string_view treeish);
+
+	// Commit ids listed by "git rev-list args..."
+	std::vector<std::string> revList(const std::vector<std::string> &args) const;
+
+	// Write the XML files from the tree of rev in a directory of
+	// cache_root named after the tree id, and return it. The directory is
+	// reused if it already exists.
+	std::filesystem::path extractXml(std::string_view rev, const std::filesystem::path &cache_root);
+
+private:
+	std::filesystem::path _path;
+	pid_t _pid;
+	FILE *_in;	// requests to cat-file
+	FILE *_out;	// responses from cat-file
+};
+
+// Split "repo.git@rev" arguments at the first '@' following an existing
+// directory (reflog selectors such as "HEAD@{1}" are kept in rev),
+// returns false for plain paths
+bool parse_git_source(std::string_view arg, std::filesystem::path &repository, std::string &rev);
+
+#endif
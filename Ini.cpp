@@ -0,0 +1,116 @@
+/*
+ * Copyright 2023 Clement Vuchener
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "Ini.h"
+
+#include <format>
+
+namespace dtml {
+
+static void print_value(std::ostream &out, std::string_view name, std::size_t value)
+{
+	out << std::format("{}={}\n", name, hex_value{value});
+}
+
+static void print_section(std::ostream &out, const Section &section)
+{
+	for (const auto &entry: section.entries)
+		print_value(out, entry.name, entry.value);
+}
+
+// 32-bit masks keep the original 8 digits format
+static int mask_width(std::size_t mask)
+{
+	return mask >> 32 ? 18 : 10;
+}
+
+static void print_flag_array(std::ostream &out, const Section &section)
+{
+	out << std::format("size={}\n", section.entries.size());
+	for (unsigned int i = 0; i < section.entries.size(); ++i) {
+		const auto &entry = section.entries[i];
+		out << std::format("{}\\name=\"{}\"\n", i+1, entry.name);
+		out << std::format("{}\\value={:#0{}x}\n", i+1, entry.value, mask_width(entry.value));
+		// Only flags outside the first word or with a value other
+		// than all ones need more than the mask
+		if (entry.word != 0)
+			out << std::format("{}\\word={}\n", i+1, entry.word);
+		if (entry.expected != entry.value)
+			out << std::format("{}\\expected={:#0{}x}\n", i+1, entry.expected, mask_width(entry.value));
+	}
+}
+
+static void print_read_plan(std::ostream &out, const Section &section)
+{
+	out << std::format("size={}\n", section.entries.size());
+	for (unsigned int i = 0; i < section.entries.size(); ++i) {
+		out << std::format("{}\\type=\"{}\"\n", i+1, section.entries[i].name);
+		out << std::format("{}\\start={}\n", i+1, hex_value{section.entries[i].value});
+		out << std::format("{}\\length={}\n", i+1, hex_value{section.entries[i].length});
+	}
+}
+
+static void print_types(std::ostream &out, const Section &section)
+{
+	for (const auto &entry: section.entries) {
+		out << std::format("{}\\size={}\n", entry.name, hex_value{entry.value});
+		out << std::format("{}\\kind={}\n", entry.name, kind_name(entry.kind));
+	}
+}
+
+static void print_enum_table(std::ostream &out, const Section &section)
+{
+	if (!section.entries.empty())
+		out << std::format("first={}\n", static_cast<std::ptrdiff_t>(section.entries.front().value));
+	out << std::format("size={}\n", section.entries.size());
+	for (unsigned int i = 0; i < section.entries.size(); ++i)
+		out << std::format("{}\\name=\"{}\"\n", i+1, section.entries[i].name);
+}
+
+void write_ini(std::ostream &out, const GeneratedLayout &layout)
+{
+	out << std::format("[info]\n");
+	out << std::format("checksum={:#010x}\n", layout.checksum);
+	out << std::format("version_name={}\n", layout.version_name);
+	out << std::format("complete=true\n");
+	out << std::format("\n");
+
+	for (const auto &section: layout.sections) {
+		out << std::format("[{}]\n", section.name);
+		switch (section.kind) {
+		case Section::Kind::Values:
+			print_section(out, section);
+			break;
+		case Section::Kind::FlagArray:
+			print_flag_array(out, section);
+			break;
+		case Section::Kind::ReadPlan:
+			print_read_plan(out, section);
+			break;
+		case Section::Kind::Types:
+			print_types(out, section);
+			break;
+		case Section::Kind::EnumTable:
+			print_enum_table(out, section);
+			break;
+		}
+		out << "\n";
+	}
+}
+
+} // namespace dtml
@@ -0,0 +1,65 @@
+/*
+ * Copyright 2023 Clement Vuchener
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef DTML_INI_H
+#define DTML_INI_H
+
+#include <format>
+#include <ostream>
+
+#include "Generator.h"
+
+namespace dtml {
+
+// Formats as 0x followed by 4 or 8 hexadecimal digits
+struct hex_value
+{
+	std::size_t value;
+};
+
+} // namespace dtml
+
+template <>
+struct std::formatter<dtml::hex_value>
+{
+	template <typename ParseContext>
+	constexpr ParseContext::iterator parse(ParseContext &ctx)
+	{
+		return ctx.begin();
+	}
+
+	template <typename FormatContext>
+	constexpr FormatContext::iterator format(dtml::hex_value v, FormatContext &ctx) const
+	{
+		int w = 4;
+		if (v.value >> 16)
+			w = 8;
+		//if (v.value >> 32)
+		//	w = 16;
+		return format_to(ctx.out(), "{:#0{}x}", v.value, w+2);
+	}
+};
+
+namespace dtml {
+
+// Write the layout in Dwarf Therapist's ini format
+void write_ini(std::ostream &out, const GeneratedLayout &layout);
+
+} // namespace dtml
+
+#endif
@@ -0,0 +1,166 @@
+/*
+ * Copyright 2023 Clement Vuchener
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "InputCache.h"
+#include "Archive.h"
+#include "MappedFile.h"
+
+#include <algorithm>
+#include <bit>
+#include <cstdlib>
+#include <cstring>
+#include <format>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <random>
+
+namespace fs = std::filesystem;
+
+static constexpr std::uint64_t HashMultiplier = 0x9e3779b97f4a7c15;
+
+void InputHash::mix(std::uint64_t word)
+{
+	state = std::rotl(state ^ word, 31) * HashMultiplier;
+}
+
+void InputHash::update(const void *data, std::size_t size)
+{
+	auto bytes = static_cast<const unsigned char *>(data);
+	length += size;
+	// Complete the word left over by the previous update
+	while (tail_length != 0 && size != 0) {
+		tail |= std::uint64_t(*bytes++) << (8*tail_length);
+		--size;
+		if (++tail_length == 8) {
+			mix(tail);
+			tail = 0;
+			tail_length = 0;
+		}
+	}
+	for (; size >= 8; bytes += 8, size -= 8) {
+		std::uint64_t word;
+		std::memcpy(&word, bytes, 8);
+		mix(word);
+	}
+	for (; size != 0; --size)
+		tail |= std::uint64_t(*bytes++) << (8*tail_length++);
+}
+
+void InputHash::update(std::string_view str)
+{
+	// Prefix with the length so that consecutive strings cannot be confused
+	std::uint64_t size = str.size();
+	update(&size, sizeof(size));
+	update(str.data(), str.size());
+}
+
+std::uint64_t InputHash::digest() const
+{
+	std::uint64_t h = std::rotl(state ^ tail, 31) * HashMultiplier;
+	h ^= length;
+	// final avalanche (from splitmix64)
+	h = (h ^ (h >> 30)) * 0xbf58476d1ce4e5b9;
+	h = (h ^ (h >> 27)) * 0x94d049bb133111eb;
+	return h ^ (h >> 31);
+}
+
+std::vector<fs::path> structures_files(const fs::path &df_structures_path)
+{
+	std::vector<fs::path> files;
+	for (const auto &entry: fs::directory_iterator(df_structures_path)) {
+		if (entry.is_regular_file() && entry.path().extension() == ".xml")
+			files.push_back(entry.path());
+	}
+	std::ranges::sort(files);
+	return files;
+}
+
+static void hash_file(InputHash &hash, const fs::path &path)
+{
+	MappedFile file(path);
+	hash.update(file.data(), file.size());
+}
+
+std::uint64_t hash_inputs(const fs::path &df_structures_path,
+			  std::string_view version_name,
+			  const fs::path &memory_layout_xml,
+			  std::string_view options)
+{
+	InputHash hash;
+	// Bump when the generated output changes for identical inputs
+	hash.update("dt-memory-layout cache v2");
+	if (is_structures_archive(df_structures_path))
+		hash_file(hash, df_structures_path);
+	else {
+		for (const auto &file: structures_files(df_structures_path)) {
+			hash.update(file.filename().string());
+			hash_file(hash, file);
+		}
+	}
+	hash.update(version_name);
+	hash_file(hash, memory_layout_xml);
+	hash.update(options);
+	return hash.digest();
+}
+
+InputCache::InputCache(fs::path directory, std::uint64_t key):
+	_path(std::move(directory) / std::format("{:016x}.ini", key))
+{
+}
+
+std::optional<fs::path> InputCache::defaultDirectory()
+{
+	if (auto xdg_cache = std::getenv("XDG_CACHE_HOME"); xdg_cache && *xdg_cache)
+		return fs::path(xdg_cache) / "dt-memory-layout";
+	if (auto home = std::getenv("HOME"); home && *home)
+		return fs::path(home) / ".cache" / "dt-memory-layout";
+	return std::nullopt;
+}
+
+std::optional<std::string> InputCache::load() const
+{
+	std::ifstream file(_path, std::ios::binary);
+	if (!file)
+		return std::nullopt;
+	return std::string(std::istreambuf_iterator<char>(file), {});
+}
+
+void InputCache::store(std::string_view content) const
+{
+	try {
+		fs::create_directories(_path.parent_path());
+		// Write to a temporary file and rename it, so that concurrent
+		// runs never see a partially written entry.
+		auto tmp = _path;
+		tmp += std::format(".{:08x}.tmp", std::random_device{}());
+		{
+			std::ofstream file(tmp, std::ios::binary | std::ios::trunc);
+			file.write(content.data(), content.size());
+			if (!file) {
+				std::cerr << std::format("Failed to write cache file {}\n", tmp.string());
+				fs::remove(tmp);
+				return;
+			}
+		}
+		fs::rename(tmp, _path);
+	}
+	catch (std::exception &e) {
+		std::cerr << std::format("Failed to store cached output: {}\n", e.what());
+	}
+}
@@ -0,0 +1,77 @@
+/*
+ * Copyright 2023 Clement Vuchener
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef INPUT_CACHE_H
+#define INPUT_CACHE_H
+
+#include <cstdint>
+#include <filesystem>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Incremental 64-bit hash, consuming input one word at a time.
+// It is only used for cache keys, not for anything security related.
+class InputHash
+{
+public:
+	void update(const void *data, std::size_t length);
+	void update(std::string_view str);
+	std::uint64_t digest() const;
+
+private:
+	void mix(std::uint64_t word);
+
+	std::uint64_t state = 0xcbf29ce484222325;
+	std::uint64_t length = 0;
+	std::uint64_t tail = 0;
+	unsigned int tail_length = 0;
+};
+
+// List the XML files of a df-structures directory, sorted by name.
+std::vector<std::filesystem::path> structures_files(const std::filesystem::path &df_structures_path);
+
+// Hash everything the generated ini depends on: the df-structures XML
+// files, the version name, the memory layout XML and the output options.
+// df_structures_path may be an archive, which is hashed without being
+// extracted.
+std::uint64_t hash_inputs(const std::filesystem::path &df_structures_path,
+			  std::string_view version_name,
+			  const std::filesystem::path &memory_layout_xml,
+			  std::string_view options = {});
+
+// Generated ini files stored by input hash.
+class InputCache
+{
+public:
+	InputCache(std::filesystem::path directory, std::uint64_t key);
+
+	// $XDG_CACHE_HOME/dt-memory-layout or ~/.cache/dt-memory-layout
+	static std::optional<std::filesystem::path> defaultDirectory();
+
+	std::optional<std::string> load() const;
+	// Errors are reported on stderr but are not fatal, the cache is only
+	// an optimization.
+	void store(std::string_view content) const;
+
+private:
+	std::filesystem::path _path;
+};
+
+#endif
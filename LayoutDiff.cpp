@@ -0,0 +1,239 @@
+/*
+ * Copyright 2023 Clement Vuchener
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "LayoutDiff.h"
+
+#include <algorithm>
+#include <format>
+#include <map>
+#include <ranges>
+
+#include "FlatLayout.h"
+#include "Ini.h"
+
+namespace dtml {
+
+// Names are unique in value sections, but other kinds may repeat them
+// (types in read plans, empty names in enum table gaps), so their entries
+// are identified by index.
+static std::string entry_name(const Section &section, std::size_t index)
+{
+	const auto &entry = section.entries[index];
+	if (section.kind == Section::Kind::Values)
+		return entry.name;
+	return std::format("{}[{}]", entry.name, index);
+}
+
+// Values compared for an entry: its value, followed by the other fields
+// used by the section kind as "name\field"
+static std::vector<std::pair<std::string, std::size_t>> entry_values(const Section &section, std::size_t index)
+{
+	const auto &entry = section.entries[index];
+	auto name = entry_name(section, index);
+	std::vector<std::pair<std::string, std::size_t>> values;
+	switch (section.kind) {
+	case Section::Kind::FlagArray:
+		values.emplace_back(std::format("{}\\word", name), entry.word);
+		values.emplace_back(std::format("{}\\expected", name), entry.expected);
+		break;
+	case Section::Kind::ReadPlan:
+		values.emplace_back(std::format("{}\\length", name), entry.length);
+		break;
+	default:
+		break;
+	}
+	values.emplace(values.begin(), std::move(name), entry.value);
+	return values;
+}
+
+using EntryKey = std::pair<std::string_view, std::string>;
+
+static std::map<EntryKey, std::size_t> layout_values(const GeneratedLayout &layout)
+{
+	std::map<EntryKey, std::size_t> values;
+	for (const auto &section: layout.sections)
+		for (std::size_t i = 0; i < section.entries.size(); ++i)
+			for (auto &[name, value]: entry_values(section, i))
+				values.emplace(EntryKey{section.name, std::move(name)}, value);
+	return values;
+}
+
+std::vector<EntryChange> diff_layouts(const GeneratedLayout &old_layout,
+				      const GeneratedLayout &new_layout,
+				      const std::vector<std::string> &sections)
+{
+	auto selected = [&sections](std::string_view name) {
+		return sections.empty() || std::ranges::find(sections, name) != sections.end();
+	};
+	std::vector<EntryChange> changes;
+	auto old_values = layout_values(old_layout);
+	auto new_values = layout_values(new_layout);
+	for (const auto &section: old_layout.sections) {
+		if (!selected(section.name))
+			continue;
+		for (std::size_t i = 0; i < section.entries.size(); ++i) {
+			for (auto &[name, value]: entry_values(section, i)) {
+				auto it = new_values.find({section.name, name});
+				if (it == new_values.end())
+					changes.push_back({section.name, std::move(name), value, std::nullopt});
+				else if (it->second != value)
+					changes.push_back({section.name, std::move(name), value, it->second});
+			}
+		}
+	}
+	for (const auto &section: new_layout.sections) {
+		if (!selected(section.name))
+			continue;
+		for (std::size_t i = 0; i < section.entries.size(); ++i) {
+			for (auto &[name, value]: entry_values(section, i)) {
+				if (!old_values.contains({section.name, name}))
+					changes.push_back({section.name, std::move(name), std::nullopt, value});
+			}
+		}
+	}
+	// group by section, keeping the entry order inside each section
+	std::vector<std::string> section_order;
+	for (const auto &change: changes)
+		if (std::ranges::find(section_order, change.section) == section_order.end())
+			section_order.push_back(change.section);
+	std::ranges::stable_sort(changes, {}, [&](const EntryChange &change) {
+		return std::ranges::find(section_order, change.section) - section_order.begin();
+	});
+	return changes;
+}
+
+static std::vector<std::string_view> split_path(std::string_view path)
+{
+	std::vector<std::string_view> components;
+	for (auto component: path | std::views::split('.'))
+		components.emplace_back(std::begin(component), std::end(component));
+	return components;
+}
+
+static std::vector<std::string> explain_offset(const Generator &old_generator,
+					       const Generator &new_generator,
+					       std::string_view type_name,
+					       std::string_view member)
+{
+	std::vector<std::string> causes;
+	const auto &old_type = old_generator.compound(type_name);
+	const auto &new_type = new_generator.compound(type_name);
+	auto components = split_path(member);
+	std::string container(type_name);
+	std::size_t old_base = 0, new_base = 0;
+	for (std::size_t i = 0; i < components.size(); ++i) {
+		// prefix of the member path up to this component
+		auto prefix = member.substr(0, components[i].end() - member.begin());
+		std::size_t old_offset, new_offset;
+		try {
+			old_offset = old_generator.offset(old_type, prefix);
+			new_offset = new_generator.offset(new_type, prefix);
+		}
+		catch (std::exception &e) {
+			causes.push_back(std::format("{}: {}", prefix, e.what()));
+			break;
+		}
+		if (old_offset - old_base != new_offset - new_base)
+			causes.push_back(std::format("{} member {} moved from {} to {}",
+					container, components[i],
+					hex_value{old_offset - old_base},
+					hex_value{new_offset - new_base}));
+		old_base = old_offset;
+		new_base = new_offset;
+		container = std::format("{}.{}", type_name, prefix);
+	}
+	return causes;
+}
+
+static std::vector<std::string> explain_size(const Generator &old_generator,
+					     const Generator &new_generator,
+					     std::string_view type_name)
+{
+	std::vector<std::string> causes;
+	const auto &old_type = old_generator.compound(type_name);
+	const auto &new_type = new_generator.compound(type_name);
+	auto old_members = direct_members(old_generator.layout(), old_generator.abi().pointer.size, old_type);
+	auto new_members = direct_members(new_generator.layout(), new_generator.abi().pointer.size, new_type);
+	for (const auto &old_member: old_members) {
+		auto it = std::ranges::find(new_members, old_member.path, &FlatMember::path);
+		if (it == new_members.end())
+			causes.push_back(std::format("{} member {} was removed", type_name, old_member.path));
+		else if (it->size != old_member.size)
+			causes.push_back(std::format("{} member {} size changed from {} to {}",
+					type_name, old_member.path,
+					hex_value{old_member.size}, hex_value{it->size}));
+	}
+	for (const auto &new_member: new_members) {
+		if (std::ranges::find(old_members, new_member.path, &FlatMember::path) == old_members.end())
+			causes.push_back(std::format("{} member {} was added", type_name, new_member.path));
+	}
+	return causes;
+}
+
+std::vector<std::string> explain_change(const Generator &old_generator,
+					const Generator &new_generator,
+					pugi::xml_node entry)
+{
+	std::string_view tag = entry.name();
+	std::string_view type = entry.attribute("type").value();
+	try {
+		if (tag == "offset")
+			return explain_offset(old_generator, new_generator, type, entry.attribute("member").value());
+		else if (tag == "size")
+			return explain_size(old_generator, new_generator, type);
+		else if (tag == "vmethod") {
+			std::string_view method = entry.attribute("method").value();
+			return {std::format("{} method {} index changed from {} to {}",
+					type, method,
+					old_generator.compound(type).methodIndex(method),
+					new_generator.compound(type).methodIndex(method))};
+		}
+		else if (tag == "global")
+			return {std::format("address of {} changed (symbols or member offsets)", entry.attribute("object").value())};
+	}
+	catch (std::exception &e) {
+		return {e.what()};
+	}
+	return {};
+}
+
+static std::string format_value(const std::optional<std::size_t> &value)
+{
+	return value ? std::format("{}", hex_value{*value}) : std::string("(missing)");
+}
+
+void write_diff(std::ostream &out, const std::vector<EntryChange> &changes)
+{
+	const std::string *section = nullptr;
+	for (const auto &change: changes) {
+		if (!section || *section != change.section) {
+			if (section)
+				out << "\n";
+			section = &change.section;
+			out << std::format("[{}]\n", change.section);
+		}
+		out << std::format("{}={} -> {}\n",
+				change.name,
+				format_value(change.old_value),
+				format_value(change.new_value));
+		for (const auto &cause: change.causes)
+			out << std::format("; {}\n", cause);
+	}
+}
+
+} // namespace dtml
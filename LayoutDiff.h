@@ -0,0 +1,66 @@
+/*
+ * Copyright 2023 Clement Vuchener
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef DTML_LAYOUT_DIFF_H
+#define DTML_LAYOUT_DIFF_H
+
+#include <optional>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "Generator.h"
+
+namespace dtml {
+
+struct EntryChange
+{
+	std::string section;
+	std::string name;
+	// missing if the entry could not be evaluated on that side
+	std::optional<std::size_t> old_value, new_value;
+	// explanations for the change, see explain_change
+	std::vector<std::string> causes = {};
+};
+
+// Entries whose value differs between two generated layouts, in the order
+// of the old layout followed by entries only present in the new layout.
+// If sections is not empty, only these sections are compared. Entries of
+// sections other than value sections are named "name[index]" since their
+// names may repeat, and their other fields are compared as
+// "name[index]\word", "name[index]\expected" (flag arrays) and
+// "name[index]\length" (read plans).
+std::vector<EntryChange> diff_layouts(const GeneratedLayout &old_layout,
+				      const GeneratedLayout &new_layout,
+				      const std::vector<std::string> &sections = {});
+
+// Find the structure changes explaining why an entry changed between two
+// generators (using different structures for the same version). Offsets
+// are explained by the members that moved along the member path, sizes
+// by the members that moved or changed size, vmethods by the method index.
+std::vector<std::string> explain_change(const Generator &old_generator,
+					const Generator &new_generator,
+					pugi::xml_node entry);
+
+// Print changes grouped by section, as "name=old -> new", followed by
+// their causes as comments.
+void write_diff(std::ostream &out, const std::vector<EntryChange> &changes);
+
+} // namespace dtml
+
+#endif
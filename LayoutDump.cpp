@@ -0,0 +1,125 @@
+/*
+ * Copyright 2023 Clement Vuchener
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "LayoutDump.h"
+
+#include <cstring>
+#include <format>
+#include <unordered_map>
+
+#include "FlatLayout.h"
+
+using namespace dfs;
+
+namespace dtml {
+
+namespace {
+
+class StringPool
+{
+public:
+	std::uint32_t add(std::string_view str)
+	{
+		auto [it, inserted] = _index.try_emplace(std::string(str), _data.size());
+		if (inserted) {
+			_data.append(str);
+			_data.push_back('\0');
+		}
+		return it->second;
+	}
+
+	const std::string &data() const { return _data; }
+
+private:
+	std::string _data;
+	std::unordered_map<std::string, std::uint32_t> _index;
+};
+
+void append_bytes(std::string &out, std::uint64_t &offset, const void *data, std::size_t size)
+{
+	out.resize((out.size() + 7) & ~std::size_t(7), '\0');
+	offset = out.size();
+	out.append(static_cast<const char *>(data), size);
+}
+
+template <typename T>
+void append_array(std::string &out, std::uint64_t &offset, const std::vector<T> &array)
+{
+	append_bytes(out, offset, array.data(), array.size() * sizeof(T));
+}
+
+} // namespace
+
+std::string make_layout_dump(const MemoryLayout &layout,
+			     std::size_t pointer_size,
+			     std::vector<std::string> &errors)
+{
+	StringPool strings;
+	std::vector<dump::Type> types;
+	std::vector<std::uint64_t> offsets, sizes;
+	std::vector<std::uint32_t> paths, member_types;
+	std::vector<std::uint8_t> kinds;
+
+	for (auto compound: all_compounds(layout)) {
+		std::vector<FlatMember> members;
+		std::size_t size;
+		try {
+			members = flatten_compound(layout, pointer_size, *compound);
+			size = type_size(layout, *compound);
+		}
+		catch (std::exception &e) {
+			errors.push_back(std::format("Skipping {}: {}.", type_name(*compound), e.what()));
+			continue;
+		}
+		types.push_back({
+			.name = strings.add(type_name(*compound)),
+			.first_member = std::uint32_t(offsets.size()),
+			.member_count = std::uint32_t(members.size()),
+			.reserved = 0,
+			.size = size,
+		});
+		for (const auto &member: members) {
+			offsets.push_back(member.offset);
+			sizes.push_back(member.size);
+			paths.push_back(strings.add(member.path));
+			member_types.push_back(strings.add(member.type ? type_name(*member.type) : "vtable"));
+			kinds.push_back(static_cast<std::uint8_t>(member.kind));
+		}
+	}
+
+	dump::Header header;
+	std::memcpy(header.magic, dump::Magic, sizeof(header.magic));
+	header.version = dump::Version;
+	header.pointer_size = pointer_size;
+	header.type_count = types.size();
+	header.member_count = offsets.size();
+	header.strings_size = strings.data().size();
+
+	std::string out(sizeof(header), '\0');
+	append_array(out, header.types, types);
+	append_array(out, header.member_offsets, offsets);
+	append_array(out, header.member_sizes, sizes);
+	append_array(out, header.member_paths, paths);
+	append_array(out, header.member_types, member_types);
+	append_array(out, header.member_kinds, kinds);
+	append_bytes(out, header.strings, strings.data().data(), strings.data().size());
+	std::memcpy(out.data(), &header, sizeof(header));
+	return out;
+}
+
+} // namespace dtml
@@ -0,0 +1,82 @@
+/*
+ * Copyright 2023 Clement Vuchener
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef DTML_LAYOUT_DUMP_H
+#define DTML_LAYOUT_DUMP_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <dfs/MemoryLayout.h>
+
+namespace dtml {
+
+// Binary dump of every compound's flattened members (--dump-all).
+//
+// The file is meant to be memory-mapped by readers. All integers use the
+// byte order of the generating machine and every array starts at an
+// offset (from the beginning of the file) aligned to 8 bytes. Members are
+// stored as columns, the members of a type are contiguous and ordered by
+// declaration. Strings are offsets in the string pool, where they are
+// NUL-terminated.
+namespace dump {
+
+inline constexpr char Magic[8] = {'D', 'T', 'M', 'L', 'D', 'U', 'M', 'P'};
+inline constexpr std::uint32_t Version = 1;
+
+struct Header
+{
+	char magic[8];
+	std::uint32_t version;
+	std::uint32_t pointer_size;
+	std::uint64_t type_count;
+	std::uint64_t member_count;
+	std::uint64_t types;		// Type[type_count]
+	std::uint64_t member_offsets;	// uint64_t[member_count]
+	std::uint64_t member_sizes;	// uint64_t[member_count]
+	std::uint64_t member_paths;	// uint32_t[member_count], string
+	std::uint64_t member_types;	// uint32_t[member_count], type name string
+	std::uint64_t member_kinds;	// uint8_t[member_count], TypeKind
+	std::uint64_t strings;		// char[strings_size]
+	std::uint64_t strings_size;
+};
+
+struct Type
+{
+	std::uint32_t name;		// string
+	std::uint32_t first_member;	// index in member columns
+	std::uint32_t member_count;
+	std::uint32_t reserved;
+	std::uint64_t size;
+};
+
+static_assert(sizeof(Header) == 96);
+static_assert(sizeof(Type) == 24);
+
+} // namespace dump
+
+// Build the dump for all compounds. Compounds whose layout cannot be
+// computed are skipped and an error message is added to errors.
+std::string make_layout_dump(const dfs::MemoryLayout &layout,
+			     std::size_t pointer_size,
+			     std::vector<std::string> &errors);
+
+} // namespace dtml
+
+#endif
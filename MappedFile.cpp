@@ -0,0 +1,90 @@
+/*
+ * Copyright 2023 Clement Vuchener
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "MappedFile.h"
+
+#include <cerrno>
+#include <format>
+#include <stdexcept>
+#include <system_error>
+
+#if defined(__unix__) || defined(__APPLE__)
+#define HAVE_MMAP
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#else
+#include <fstream>
+#endif
+
+#ifdef HAVE_MMAP
+
+MappedFile::MappedFile(const std::filesystem::path &path, Mode mode)
+{
+	int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+	if (fd == -1)
+		throw std::system_error(errno, std::generic_category(),
+				std::format("cannot open {}", path.string()));
+	struct stat st;
+	if (fstat(fd, &st) == -1) {
+		int err = errno;
+		close(fd);
+		throw std::system_error(err, std::generic_category(),
+				std::format("cannot stat {}", path.string()));
+	}
+	_size = st.st_size;
+	if (_size != 0) {
+		int prot = mode == Private ? PROT_READ | PROT_WRITE : PROT_READ;
+		void *addr = mmap(nullptr, _size, prot, MAP_PRIVATE, fd, 0);
+		if (addr == MAP_FAILED) {
+			int err = errno;
+			close(fd);
+			throw std::system_error(err, std::generic_category(),
+					std::format("cannot map {}", path.string()));
+		}
+		_data = static_cast<char *>(addr);
+	}
+	// the mapping stays valid after closing the file descriptor
+	close(fd);
+}
+
+MappedFile::~MappedFile()
+{
+	if (_data)
+		munmap(_data, _size);
+}
+
+#else
+
+MappedFile::MappedFile(const std::filesystem::path &path, Mode)
+{
+	std::ifstream file(path, std::ios::binary);
+	if (!file)
+		throw std::runtime_error(std::format("cannot open {}", path.string()));
+	_buffer.resize(std::filesystem::file_size(path));
+	file.read(_buffer.data(), _buffer.size());
+	_data = _buffer.data();
+	_size = file.gcount();
+}
+
+MappedFile::~MappedFile()
+{
+}
+
+#endif
@@ -0,0 +1,57 @@
+/*
+ * Copyright 2023 Clement Vuchener
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef MAPPED_FILE_H
+#define MAPPED_FILE_H
+
+#include <cstddef>
+#include <filesystem>
+#include <string_view>
+#include <vector>
+
+// Read-only or copy-on-write view of a whole file.
+//
+// The file is memory-mapped when the platform supports it, otherwise its
+// content is read into a buffer.
+class MappedFile
+{
+public:
+	enum Mode {
+		ReadOnly,
+		// Writes modify the mapping but not the file (for in-place parsing)
+		Private,
+	};
+
+	MappedFile(const std::filesystem::path &path, Mode mode = ReadOnly);
+	~MappedFile();
+
+	MappedFile(const MappedFile &) = delete;
+	MappedFile &operator=(const MappedFile &) = delete;
+
+	char *data() { return _data; }
+	const char *data() const { return _data; }
+	std::size_t size() const { return _size; }
+	std::string_view view() const { return {_data, _size}; }
+
+private:
+	char *_data = nullptr;
+	std::size_t _size = 0;
+	std::vector<char> _buffer; // used when mmap is not available
+};
+
+#endif
@@ -0,0 +1,111 @@
+/*
+ * Copyright 2023 Clement Vuchener
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "MemberIndex.h"
+
+#include <algorithm>
+#include <format>
+
+#include "FlatLayout.h"
+#include "TypeInspection.h"
+
+using namespace dfs;
+
+namespace dtml {
+
+MemberIndex::MemberIndex(const MemoryLayout &layout, std::size_t pointer_size):
+	_layout(layout),
+	_pointer_size(pointer_size)
+{
+}
+
+const std::vector<MemberIndex::Interval> &MemberIndex::intervals(const Compound &compound) const
+{
+	auto [it, inserted] = _intervals.try_emplace(&compound);
+	if (inserted) {
+		auto &intervals = it->second;
+		for (auto &member: direct_members(_layout, _pointer_size, compound)) {
+			if (member.size == 0)
+				continue;
+			intervals.push_back({
+				member.offset, member.offset + member.size, 0,
+				std::move(member.path), member.type,
+			});
+		}
+		std::ranges::stable_sort(intervals, {}, &Interval::begin);
+		std::size_t max_end = 0;
+		for (auto &interval: intervals)
+			interval.max_end = max_end = std::max(max_end, interval.end);
+	}
+	return it->second;
+}
+
+void MemberIndex::find(const AbstractType &type, std::size_t base, std::size_t offset,
+		       const std::string &path, std::vector<Result> &results) const
+{
+	if (auto compound = dynamic_cast<const Compound *>(&type)) {
+		const auto &index = intervals(*compound);
+		// Last interval starting at or before offset, then walk back
+		// while previous intervals may still contain it.
+		auto it = std::ranges::upper_bound(index, offset, {}, &Interval::begin);
+		std::vector<const Interval *> matches;
+		while (it != index.begin() && std::prev(it)->max_end > offset) {
+			--it;
+			if (it->end > offset)
+				matches.push_back(&*it);
+		}
+		if (!matches.empty()) {
+			// report in offset order
+			std::ranges::reverse(matches);
+			for (auto interval: matches) {
+				auto member_path = path.empty() ? interval->name : path + "." + interval->name;
+				if (!interval->type) {
+					// vtable pointer
+					results.push_back({member_path, base + interval->begin, nullptr});
+					continue;
+				}
+				find(*interval->type, base + interval->begin, offset - interval->begin,
+						member_path, results);
+			}
+			return;
+		}
+		if (!path.empty())
+			results.push_back({path, base, &type});
+		return;
+	}
+	if (auto item_type = array_item_type(type)) {
+		auto item_size = type_size(_layout, *item_type);
+		if (item_size != 0) {
+			auto index = offset / item_size;
+			find(*item_type, base + index * item_size, offset % item_size,
+					std::format("{}[{}]", path, index), results);
+			return;
+		}
+	}
+	results.push_back({path, base, &type});
+}
+
+std::vector<MemberIndex::Result> MemberIndex::find(const Compound &compound, std::size_t offset) const
+{
+	std::vector<Result> results;
+	if (offset < type_size(_layout, compound))
+		find(compound, 0, offset, {}, results);
+	return results;
+}
+
+} // namespace dtml
@@ -0,0 +1,74 @@
+/*
+ * Copyright 2023 Clement Vuchener
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef DTML_MEMBER_INDEX_H
+#define DTML_MEMBER_INDEX_H
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include <dfs/MemoryLayout.h>
+
+namespace dtml {
+
+// Reverse lookup from an offset to the members containing it.
+//
+// Each compound gets an interval index over its direct members (including
+// inherited members and the vtable pointer), built the first time the
+// compound is searched. Lookup is logarithmic at each nesting level: it
+// recurses into nested compounds and computes the index in static arrays
+// instead of listing every item. Unions may give several results.
+class MemberIndex
+{
+public:
+	struct Result
+	{
+		std::string path;		// member path, with array indices
+		std::size_t member_offset;	// offset of the innermost member
+		const dfs::AbstractType *type;	// type of the innermost member,
+						// nullptr for the vtable pointer
+	};
+
+	// pointer_size is the size of vtable pointers
+	MemberIndex(const dfs::MemoryLayout &layout, std::size_t pointer_size);
+
+	// Empty if offset is in padding or out of the compound
+	std::vector<Result> find(const dfs::Compound &compound, std::size_t offset) const;
+
+private:
+	struct Interval
+	{
+		std::size_t begin, end;
+		std::size_t max_end;	// maximum end of this and previous intervals
+		std::string name;
+		const dfs::AbstractType *type;
+	};
+
+	const std::vector<Interval> &intervals(const dfs::Compound &compound) const;
+	void find(const dfs::AbstractType &type, std::size_t base, std::size_t offset,
+		  const std::string &path, std::vector<Result> &results) const;
+
+	const dfs::MemoryLayout &_layout;
+	std::size_t _pointer_size;
+	mutable std::map<const dfs::Compound *, std::vector<Interval>> _intervals;
+};
+
+} // namespace dtml
+
+#endif
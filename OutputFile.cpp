@@ -0,0 +1,132 @@
+/*
+ * Copyright 2023 Clement Vuchener
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "OutputFile.h"
+
+#include <algorithm>
+#include <format>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <random>
+#include <stdexcept>
+
+namespace fs = std::filesystem;
+
+bool write_if_changed(const fs::path &path, std::string_view content)
+{
+	{
+		std::ifstream file(path, std::ios::binary);
+		if (file) {
+			std::error_code ec;
+			auto size = fs::file_size(path, ec);
+			if (!ec && size == content.size() &&
+					std::equal(content.begin(), content.end(),
+						std::istreambuf_iterator<char>(file)))
+				return true;
+		}
+	}
+	// Write to a temporary file and rename it, so that an interrupted
+	// run never leaves a truncated file newer than its inputs.
+	auto tmp = path;
+	tmp += std::format(".{:08x}.tmp", std::random_device{}());
+	{
+		std::ofstream file(tmp, std::ios::binary | std::ios::trunc);
+		file.write(content.data(), content.size());
+		if (!file) {
+			std::cerr << std::format("Failed to write {}\n", tmp.string());
+			std::error_code ec;
+			fs::remove(tmp, ec);
+			return false;
+		}
+	}
+	std::error_code ec;
+	fs::rename(tmp, path, ec);
+	if (ec) {
+		std::cerr << std::format("Failed to write {}: {}\n", path.string(), ec.message());
+		fs::remove(tmp, ec);
+		return false;
+	}
+	return true;
+}
+
+static std::string escape_depfile_path(const fs::path &path)
+{
+	std::string escaped;
+	for (char c: path.string()) {
+		switch (c) {
+		case ' ':
+		case '#':
+			escaped.push_back('\\');
+			break;
+		case '$':
+			escaped.push_back('$');
+			break;
+		}
+		escaped.push_back(c);
+	}
+	return escaped;
+}
+
+bool write_depfile(const fs::path &depfile,
+		   const fs::path &target,
+		   std::span<const fs::path> dependencies)
+{
+	std::string content = std::format("{}:", escape_depfile_path(target));
+	for (const auto &dep: dependencies)
+		content += std::format(" \\\n  {}", escape_depfile_path(dep));
+	content += "\n";
+	return write_if_changed(depfile, content);
+}
+
+StagingDirectory::StagingDirectory(fs::path directory):
+	_directory(std::move(directory)),
+	_tmp(_directory)
+{
+	_tmp += std::format(".{:08x}.tmp", std::random_device{}());
+	fs::create_directories(_tmp);
+}
+
+StagingDirectory::~StagingDirectory()
+{
+	if (!_committed) {
+		std::error_code ec;
+		fs::remove_all(_tmp, ec);
+	}
+}
+
+void StagingDirectory::writeFile(std::string_view name, std::string_view content)
+{
+	auto path = _tmp / name;
+	std::ofstream file(path, std::ios::binary);
+	file.write(content.data(), content.size());
+	if (!file)
+		throw std::runtime_error(std::format("failed to write {}", path.string()));
+}
+
+void StagingDirectory::commit()
+{
+	std::error_code ec;
+	fs::rename(_tmp, _directory, ec);
+	if (ec) {
+		if (!fs::is_directory(_directory))
+			throw fs::filesystem_error("cannot rename staging directory", _tmp, _directory, ec);
+		return; // removed by the destructor
+	}
+	_committed = true;
+}
@@ -0,0 +1,59 @@
+/*
+ * Copyright 2023 Clement Vuchener
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef OUTPUT_FILE_H
+#define OUTPUT_FILE_H
+
+#include <filesystem>
+#include <span>
+#include <string_view>
+
+// Replace the content of path, unless it is already identical so that its
+// modification time is kept. The file is replaced atomically by renaming a
+// temporary file. Returns false if the file could not be written.
+bool write_if_changed(const std::filesystem::path &path, std::string_view content);
+
+// Write a Make/Ninja depfile declaring that target depends on dependencies.
+bool write_depfile(const std::filesystem::path &depfile,
+		   const std::filesystem::path &target,
+		   std::span<const std::filesystem::path> dependencies);
+
+// Temporary directory renamed to its final path once complete, so that
+// interrupted or concurrent runs never see a partially written directory.
+// It is removed if commit is not called.
+class StagingDirectory
+{
+public:
+	explicit StagingDirectory(std::filesystem::path directory);
+	~StagingDirectory();
+
+	StagingDirectory(const StagingDirectory &) = delete;
+	StagingDirectory &operator=(const StagingDirectory &) = delete;
+
+	const std::filesystem::path &path() const { return _tmp; }
+	void writeFile(std::string_view name, std::string_view content);
+	// Another process may commit the same directory first, then this
+	// one is discarded.
+	void commit();
+
+private:
+	std::filesystem::path _directory, _tmp;
+	bool _committed = false;
+};
+
+#endif
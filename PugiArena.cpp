@@ -0,0 +1,124 @@
+/*
+ * Copyright 2023 Clement Vuchener
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "PugiArena.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <vector>
+
+#include <pugixml.hpp>
+
+namespace {
+
+constexpr std::size_t ChunkSize = 1024*1024;
+constexpr std::size_t Alignment = alignof(std::max_align_t);
+
+struct Chunk
+{
+	struct Free { void operator()(char *p) const { std::free(p); } };
+	std::unique_ptr<char, Free> data;
+	std::size_t size;
+};
+
+class Arena
+{
+public:
+	void *allocate(std::size_t size)
+	{
+		std::lock_guard lock(_mutex);
+		size = (size + Alignment - 1) & ~(Alignment - 1);
+		++_stats.allocations;
+		_stats.bytes += size;
+		// find a chunk with enough room, starting from the current one
+		while (_current < _chunks.size() && _used + size > _chunks[_current].size) {
+			++_current;
+			_used = 0;
+		}
+		if (_current == _chunks.size()) {
+			std::size_t chunk_size = std::max(size, ChunkSize);
+			auto p = static_cast<char *>(std::malloc(chunk_size));
+			if (!p)
+				return nullptr;
+			_chunks.push_back({std::unique_ptr<char, Chunk::Free>(p), chunk_size});
+			++_stats.chunks;
+			_stats.chunk_bytes += chunk_size;
+			_used = 0;
+		}
+		void *p = _chunks[_current].data.get() + _used;
+		_used += size;
+		++_live;
+		return p;
+	}
+
+	void deallocate(void *)
+	{
+		std::lock_guard lock(_mutex);
+		if (--_live == 0) {
+			_current = 0;
+			_used = 0;
+			++_stats.rewinds;
+		}
+	}
+
+	PugiArena::Stats stats()
+	{
+		std::lock_guard lock(_mutex);
+		return _stats;
+	}
+
+private:
+	std::mutex _mutex;
+	std::vector<Chunk> _chunks;
+	std::size_t _current = 0;
+	std::size_t _used = 0;
+	std::size_t _live = 0;
+	PugiArena::Stats _stats;
+};
+
+Arena &arena()
+{
+	// never destroyed: pugixml objects with static storage may outlive it
+	static Arena *arena = new Arena;
+	return *arena;
+}
+
+void *arena_allocate(std::size_t size)
+{
+	return arena().allocate(size);
+}
+
+void arena_deallocate(void *p)
+{
+	arena().deallocate(p);
+}
+
+} // namespace
+
+void PugiArena::install()
+{
+	pugi::set_memory_management_functions(arena_allocate, arena_deallocate);
+}
+
+PugiArena::Stats PugiArena::stats()
+{
+	return arena().stats();
+}
@@ -0,0 +1,47 @@
+/*
+ * Copyright 2023 Clement Vuchener
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef PUGI_ARENA_H
+#define PUGI_ARENA_H
+
+#include <cstddef>
+
+// Monotonic arena used for all pugixml allocations.
+//
+// pugixml already groups nodes in pages, the arena groups these pages (and
+// large strings) in bigger chunks. Deallocation only decrements a counter:
+// once every pugixml allocation has been freed (e.g. after a document is
+// destroyed), the arena is rewound and its chunks are reused for the next
+// document. Chunks are only released at exit.
+namespace PugiArena
+{
+	struct Stats
+	{
+		std::size_t allocations = 0;	// calls to the allocation function
+		std::size_t bytes = 0;		// total bytes requested
+		std::size_t chunks = 0;		// chunks allocated from the system
+		std::size_t chunk_bytes = 0;	// total size of the chunks
+		std::size_t rewinds = 0;	// times the arena was reset
+	};
+
+	// Must be called before any pugixml object is created.
+	void install();
+	Stats stats();
+}
+
+#endif
@@ -0,0 +1,160 @@
+/*
+ * Copyright 2023 Clement Vuchener
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "Repl.h"
+
+#include <algorithm>
+#include <format>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "Ini.h"
+#include "TypeInspection.h"
+
+static constexpr std::string_view Help =
+	"offset TYPE MEMBER     offset of MEMBER in TYPE\n"
+	"size TYPE              size of TYPE\n"
+	"vmethod TYPE METHOD    offset of METHOD in the vtable of TYPE\n"
+	"global OBJECT          address of a global object\n"
+	"value ENUM VALUE       value of an enum item\n"
+	"vtable TYPE            address of the vtable of TYPE\n"
+	"flags BITFIELD F1|F2   bitfield value with the given flags set\n"
+	"                       (F=VALUE for multi-bit flags)\n"
+	"whereis TYPE OFFSET    members of TYPE containing OFFSET\n"
+	"help                   print this help\n"
+	"quit                   exit\n";
+
+Repl::Repl(const dtml::Generator &generator):
+	_generator(generator),
+	_index(generator.layout(), generator.abi().pointer.size)
+{
+}
+
+void Repl::whereis(std::string_view type, std::string_view offset_str, std::ostream &out) const
+{
+	std::size_t offset;
+	try {
+		offset = std::stoull(std::string(offset_str), nullptr, 0);
+	}
+	catch (std::exception &) {
+		throw std::runtime_error(std::format("invalid offset {}", offset_str));
+	}
+	auto results = _index.find(_generator.compound(type), offset);
+	if (results.empty()) {
+		out << std::format("no member at {}\n", dtml::hex_value{offset}) << std::flush;
+		return;
+	}
+	std::string line;
+	for (const auto &result: results) {
+		if (!line.empty())
+			line += "; ";
+		line += std::format("{}+{} ({})",
+				result.path,
+				dtml::hex_value{offset - result.member_offset},
+				result.type ? dtml::type_name(*result.type) : "vtable");
+	}
+	out << line << "\n" << std::flush;
+}
+
+bool Repl::execute(std::string_view line, std::ostream &out) const
+{
+	std::vector<std::string_view> args;
+	static constexpr std::string_view Spaces = " \t\r";
+	for (auto begin = line.find_first_not_of(Spaces); begin != line.npos; ) {
+		auto end = std::min(line.find_first_of(Spaces, begin), line.size());
+		args.push_back(line.substr(begin, end - begin));
+		begin = line.find_first_not_of(Spaces, end);
+	}
+	if (args.empty())
+		return true;
+
+	auto command = args[0];
+	auto need_args = [&](std::size_t count, std::string_view usage) {
+		if (args.size() != count + 1)
+			throw std::runtime_error(std::format("usage: {} {}", command, usage));
+	};
+	try {
+		std::size_t value;
+		if (command == "offset") {
+			need_args(2, "TYPE MEMBER");
+			value = _generator.offset(_generator.compound(args[1]), args[2]);
+		}
+		else if (command == "size") {
+			need_args(1, "TYPE");
+			value = _generator.size(_generator.compound(args[1]));
+		}
+		else if (command == "vmethod") {
+			need_args(2, "TYPE METHOD");
+			value = _generator.vmethod(_generator.compound(args[1]), args[2]);
+		}
+		else if (command == "global") {
+			need_args(1, "OBJECT");
+			value = _generator.global(args[1]);
+		}
+		else if (command == "value") {
+			need_args(2, "ENUM VALUE");
+			value = _generator.enumValue(args[1], args[2]);
+		}
+		else if (command == "vtable") {
+			need_args(1, "TYPE");
+			value = _generator.vtable(args[1]);
+		}
+		else if (command == "flags") {
+			need_args(2, "BITFIELD FLAGS");
+			auto [word, mask, flags_value] = _generator.flags(args[1], args[2]);
+			if (word != 0 || mask != flags_value) {
+				out << std::format("{} (word {}, mask {})\n",
+						dtml::hex_value{flags_value}, word, dtml::hex_value{mask}) << std::flush;
+				return true;
+			}
+			value = flags_value;
+		}
+		else if (command == "whereis") {
+			need_args(2, "TYPE OFFSET");
+			whereis(args[1], args[2], out);
+			return true;
+		}
+		else if (command == "help") {
+			out << Help << std::flush;
+			return true;
+		}
+		else if (command == "quit" || command == "exit")
+			return false;
+		else
+			throw std::runtime_error(std::format("unknown command {}, try help", command));
+		out << std::format("{}\n", dtml::hex_value{value}) << std::flush;
+	}
+	catch (std::exception &e) {
+		out << std::format("error: {}\n", e.what()) << std::flush;
+	}
+	return true;
+}
+
+void Repl::run(std::istream &in, std::ostream &out) const
+{
+	std::string line;
+	// the prompt goes to stderr so that the output only contains results
+	std::cerr << "> " << std::flush;
+	while (std::getline(in, line)) {
+		if (!execute(line, out))
+			break;
+		std::cerr << "> " << std::flush;
+	}
+}
@@ -0,0 +1,49 @@
+/*
+ * Copyright 2023 Clement Vuchener
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef REPL_H
+#define REPL_H
+
+#include <istream>
+#include <ostream>
+#include <string_view>
+
+#include "Generator.h"
+#include "MemberIndex.h"
+
+// Interactive queries evaluated with the same code as layout entries.
+//
+// Each query line produces exactly one output line, either the value or
+// an error message, so the REPL can also be driven by scripts.
+class Repl
+{
+public:
+	explicit Repl(const dtml::Generator &generator);
+
+	// Evaluate one query line, returns false when the user asked to quit
+	bool execute(std::string_view line, std::ostream &out) const;
+	void run(std::istream &in, std::ostream &out) const;
+
+private:
+	void whereis(std::string_view type, std::string_view offset, std::ostream &out) const;
+
+	const dtml::Generator &_generator;
+	dtml::MemberIndex _index;
+};
+
+#endif
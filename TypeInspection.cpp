@@ -0,0 +1,152 @@
+/*
+ * Copyright 2023 Clement Vuchener
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "TypeInspection.h"
+
+#include <format>
+#include <stdexcept>
+
+using namespace dfs;
+
+namespace dtml {
+
+std::string_view kind_name(TypeKind kind)
+{
+	switch (kind) {
+	case TypeKind::Other: return "other";
+	case TypeKind::Int8: return "int8";
+	case TypeKind::UInt8: return "uint8";
+	case TypeKind::Int16: return "int16";
+	case TypeKind::UInt16: return "uint16";
+	case TypeKind::Int32: return "int32";
+	case TypeKind::UInt32: return "uint32";
+	case TypeKind::Int64: return "int64";
+	case TypeKind::UInt64: return "uint64";
+	case TypeKind::Bool: return "bool";
+	case TypeKind::Float: return "float";
+	case TypeKind::Double: return "double";
+	case TypeKind::Pointer: return "pointer";
+	case TypeKind::StdString: return "std::string";
+	case TypeKind::StdVector: return "std::vector";
+	case TypeKind::Container: return "container";
+	case TypeKind::Enum: return "enum";
+	case TypeKind::Bitfield: return "bitfield";
+	case TypeKind::Compound: return "compound";
+	case TypeKind::StaticArray: return "static-array";
+	}
+	return "other";
+}
+
+static TypeKind integer_kind(std::size_t size, bool is_signed)
+{
+	switch (size) {
+	case 1: return is_signed ? TypeKind::Int8 : TypeKind::UInt8;
+	case 2: return is_signed ? TypeKind::Int16 : TypeKind::UInt16;
+	case 4: return is_signed ? TypeKind::Int32 : TypeKind::UInt32;
+	case 8: return is_signed ? TypeKind::Int64 : TypeKind::UInt64;
+	default: return TypeKind::Other;
+	}
+}
+
+TypeKind type_kind(const AbstractType &type, std::size_t size)
+{
+	if (auto primitive = dynamic_cast<const PrimitiveType *>(&type)) {
+		switch (primitive->type) {
+		case PrimitiveType::Int8:
+		case PrimitiveType::Char:
+			return TypeKind::Int8;
+		case PrimitiveType::UInt8: return TypeKind::UInt8;
+		case PrimitiveType::Int16: return TypeKind::Int16;
+		case PrimitiveType::UInt16: return TypeKind::UInt16;
+		case PrimitiveType::Int32: return TypeKind::Int32;
+		case PrimitiveType::UInt32: return TypeKind::UInt32;
+		case PrimitiveType::Int64: return TypeKind::Int64;
+		case PrimitiveType::UInt64: return TypeKind::UInt64;
+		case PrimitiveType::Long: return integer_kind(size, true);
+		case PrimitiveType::ULong:
+		case PrimitiveType::SizeT:
+			return integer_kind(size, false);
+		case PrimitiveType::Bool: return TypeKind::Bool;
+		case PrimitiveType::SFloat: return TypeKind::Float;
+		case PrimitiveType::DFloat: return TypeKind::Double;
+		case PrimitiveType::PtrString: return TypeKind::Pointer;
+		case PrimitiveType::StdString: return TypeKind::StdString;
+		default: return TypeKind::Other;
+		}
+	}
+	if (dynamic_cast<const PointerType *>(&type))
+		return TypeKind::Pointer;
+	if (auto container = dynamic_cast<const StdContainer *>(&type))
+		return container->container_type == StdContainer::StdVector
+			? TypeKind::StdVector
+			: TypeKind::Container;
+	if (dynamic_cast<const Enum *>(&type))
+		return TypeKind::Enum;
+	if (dynamic_cast<const Bitfield *>(&type))
+		return TypeKind::Bitfield;
+	if (dynamic_cast<const Compound *>(&type))
+		return TypeKind::Compound;
+	if (dynamic_cast<const StaticArray *>(&type))
+		return TypeKind::StaticArray;
+	return TypeKind::Other;
+}
+
+std::string_view type_name(const AbstractType &type)
+{
+	return type.debug_name;
+}
+
+const AbstractType *array_item_type(const AbstractType &type)
+{
+	if (auto array = dynamic_cast<const StaticArray *>(&type))
+		return &array->item_type.get();
+	return nullptr;
+}
+
+const AbstractType *pointed_type(const PointerType &pointer)
+{
+	return pointer.type ? &pointer.type.get() : nullptr;
+}
+
+const AbstractType *vector_item_type(const AbstractType &type)
+{
+	auto container = dynamic_cast<const StdContainer *>(&type);
+	if (!container || container->container_type != StdContainer::StdVector || container->type_params.empty())
+		return nullptr;
+	return &container->type_params[0].get();
+}
+
+const Compound *compound_parent(const Compound &compound)
+{
+	return compound.parent;
+}
+
+bool has_virtual_methods(const Compound &compound)
+{
+	return !compound.vmethods.empty();
+}
+
+std::size_t type_size(const MemoryLayout &layout, const AbstractType &type)
+{
+	auto it = layout.type_info.find(&type);
+	if (it == layout.type_info.end())
+		throw std::runtime_error(std::format("missing type info for {}", type_name(type)));
+	return it->second.size;
+}
+
+} // namespace dtml
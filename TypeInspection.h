@@ -0,0 +1,83 @@
+/*
+ * Copyright 2023 Clement Vuchener
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef DTML_TYPE_INSPECTION_H
+#define DTML_TYPE_INSPECTION_H
+
+#include <cstdint>
+#include <string_view>
+
+#include <dfs/Type.h>
+#include <dfs/MemoryLayout.h>
+
+namespace dtml {
+
+// Coarse classification of types, as needed by memory readers
+enum class TypeKind: std::uint8_t
+{
+	Other = 0,
+	Int8,
+	UInt8,
+	Int16,
+	UInt16,
+	Int32,
+	UInt32,
+	Int64,
+	UInt64,
+	Bool,
+	Float,
+	Double,
+	Pointer,
+	StdString,
+	StdVector,
+	Container,	// any other container
+	Enum,
+	Bitfield,
+	Compound,
+	StaticArray,
+};
+
+std::string_view kind_name(TypeKind kind);
+
+// size is the size of the type from the memory layout, it is used for
+// primitive types whose size depends on the ABI (long, size_t).
+TypeKind type_kind(const dfs::AbstractType &type, std::size_t size);
+
+std::string_view type_name(const dfs::AbstractType &type);
+
+// Item type of a static array, nullptr for other types
+const dfs::AbstractType *array_item_type(const dfs::AbstractType &type);
+
+// Item type of a std::vector, nullptr for other types
+const dfs::AbstractType *vector_item_type(const dfs::AbstractType &type);
+
+// Type pointed to, nullptr for untyped (void) pointers
+const dfs::AbstractType *pointed_type(const dfs::PointerType &pointer);
+
+// Compound this one inherits from, nullptr if there is none
+const dfs::Compound *compound_parent(const dfs::Compound &compound);
+
+// True if the compound declares virtual methods (not counting its parents)
+bool has_virtual_methods(const dfs::Compound &compound);
+
+// Size from the memory layout, throws std::runtime_error if it is missing
+std::size_t type_size(const dfs::MemoryLayout &layout, const dfs::AbstractType &type);
+
+} // namespace dtml
+
+#endif
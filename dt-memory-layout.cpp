@@ -17,299 +17,660 @@
  */
 
 #include <filesystem>
+#include <fstream>
 #include <iostream>
-#include <iomanip>
+#include <sstream>
+#include <chrono>
+#include <memory>
+#include <optional>
+#include <map>
+#include <span>
+#include <future>
 #include <algorithm>
 
 #include <format>
-#include <ranges>
+
+#include "AllocationCounter.h"
+#include "Archive.h"
+#include "CppHeader.h"
+#include "Generator.h"
+#include "Ini.h"
+#include "InputCache.h"
+#include "LayoutDiff.h"
+#include "LayoutDump.h"
+#include "OutputFile.h"
+#include "PugiArena.h"
+#include "Repl.h"
+#ifdef HAVE_INOTIFY
+#include "FileWatcher.h"
+#endif
+#ifdef HAVE_GIT_SOURCES
+#include "Bisect.h"
+#include "GitRepository.h"
+#endif
 
 #include <dfs/Structures.h>
 #include <dfs/ABI.h>
 #include <dfs/MemoryLayout.h>
-#include <dfs/Path.h>
-#include <dfs/Pointer.h>
 using namespace dfs;
 
-#include <pugixml.hpp>
-using namespace pugi;
-
 namespace fs = std::filesystem;
 
-struct hex_value
+static const Structures::VersionInfo *find_version(const Structures &structures, const char *version_name)
+{
+	auto version = structures.versionByName(version_name);
+	if (!version) {
+		std::cerr << std::format("Version \"{}\" not found\n", version_name);
+		std::cerr << std::format("Available versions are:\n");
+		for (const auto &version: structures.allVersions())
+			std::cerr << std::format(" - {}\n", version.version_name);
+	}
+	return version;
+}
+
+// Directory to load the structures from, owning the temporary directory
+// of archives.
+struct StructuresDirectory
 {
-	std::size_t value;
+	fs::path path;
+	std::unique_ptr<StagingDirectory> extracted = {};
+
+	operator const fs::path &() const { return path; }
 };
 
-template <>
-struct std::formatter<hex_value>
+// df_structures_path may also be an archive, extracted to a temporary
+// directory, or "repo.git@rev", whose XML files are extracted in the cache
+// directory.
+static StructuresDirectory structures_directory(std::string_view arg, [[maybe_unused]] const std::optional<fs::path> &cache_dir)
 {
-	template <typename ParseContext>
-	constexpr ParseContext::iterator parse(ParseContext &ctx)
-	{
-		return ctx.begin();
+	if (is_structures_archive(arg)) {
+		auto extracted = extract_structures_archive(arg);
+		auto path = extracted->path();
+		return {std::move(path), std::move(extracted)};
+	}
+#ifdef HAVE_GIT_SOURCES
+	fs::path repository;
+	std::string rev;
+	if (parse_git_source(arg, repository, rev)) {
+		auto cache_root = cache_dir.value_or(fs::temp_directory_path() / "dt-memory-layout");
+		GitRepository git(repository);
+		return {git.extractXml(rev, cache_root / "git")};
 	}
+#endif
+	return {fs::path(arg)};
+}
 
-	template <typename FormatContext>
-	constexpr FormatContext::iterator format(hex_value v, FormatContext &ctx) const
-	{
-		int w = 4;
-		if (v.value >> 16)
-			w = 8;
-		//if (v.value >> 32)
-		//	w = 16;
-		return format_to(ctx.out(), "{:#0{}x}", v.value, w+2);
+#ifdef HAVE_GIT_SOURCES
+// Files that change when rev moves: the loose and packed refs it may name
+// (and the branch HEAD points to). Object ids never move and need none.
+static std::vector<fs::path> git_ref_files(const fs::path &repository, std::string_view rev)
+{
+	auto git_dir = fs::is_directory(repository / ".git") ? repository / ".git" : repository;
+	std::vector<fs::path> candidates = {
+		git_dir / "packed-refs",
+		git_dir / rev,
+		git_dir / "refs" / "heads" / rev,
+		git_dir / "refs" / "tags" / rev,
+		git_dir / "refs" / "remotes" / rev,
+	};
+	if (rev == "HEAD") {
+		std::ifstream head(git_dir / "HEAD");
+		std::string line;
+		if (std::getline(head, line) && line.starts_with("ref: "))
+			candidates.push_back(git_dir / line.substr(5));
 	}
+	std::vector<fs::path> files;
+	for (auto &candidate: candidates)
+		if (fs::is_regular_file(candidate))
+			files.push_back(std::move(candidate));
+	return files;
+}
+#endif
+
+// Input files of the structures argument for depfiles: the archive itself
+// rather than its extracted files, refs for git sources.
+static std::vector<fs::path> structures_dependencies(std::string_view arg)
+{
+	if (is_structures_archive(arg))
+		return {fs::path(arg)};
+#ifdef HAVE_GIT_SOURCES
+	fs::path repository;
+	std::string rev;
+	if (parse_git_source(arg, repository, rev))
+		return git_ref_files(repository, rev);
+#endif
+	return structures_files(fs::path(arg));
+}
+
+enum class OutputFormat
+{
+	Ini,
+	CppHeader,
 };
 
-static void print_value(std::string_view name, std::size_t value)
+static bool generate(std::ostream &out, const Structures &structures,
+		     const char *version_name, const fs::path &memory_layout_xml,
+		     const dtml::GenerateOptions &options, OutputFormat format)
 {
-	std::cout << std::format("{}={}\n", name, hex_value{value});
+	auto version = find_version(structures, version_name);
+	if (!version)
+		return false;
+
+	const ABI &abi = ABI::fromVersionName(version_name);
+
+	MemoryLayout layout(structures, abi);
+
+	std::optional<dtml::LayoutDescription> description;
+	try {
+		description.emplace(memory_layout_xml);
+	}
+	catch (std::exception &e) {
+		std::cerr << std::format("{}\n", e.what());
+		return false;
+	}
+
+	dtml::Generator generator(structures, *version, abi, layout);
+	if (format == OutputFormat::CppHeader) {
+		std::vector<std::string> errors;
+		dtml::write_cpp_header(out, generator, *description, errors);
+		for (const auto &error: errors)
+			std::cerr << error << "\n";
+		return errors.empty();
+	}
+	auto result = generator.generate(*description, options);
+	for (const auto &error: result.errors)
+		std::cerr << error << "\n";
+	for (const auto &warning: result.warnings)
+		std::cerr << std::format("warning: {}\n", warning);
+	dtml::write_ini(out, result);
+	return result.ok();
 }
 
-static bool print_section(const Structures &structures, const Structures::VersionInfo &version,
-			  const ABI &abi, const MemoryLayout &layout, const xml_node element)
+static int repl(const fs::path &df_structures_path, const char *version_name)
 {
+	Structures structures(df_structures_path);
+	auto version = find_version(structures, version_name);
+	if (!version)
+		return EXIT_FAILURE;
+	const ABI &abi = ABI::fromVersionName(version_name);
+	MemoryLayout layout(structures, abi);
+	dtml::Generator generator(structures, *version, abi, layout);
+	Repl(generator).run(std::cin, std::cout);
+	return EXIT_SUCCESS;
+}
+
+// Evaluate the same layout for two versions, sharing the memory layout
+// when both versions use the same ABI.
+static int diff_versions(const fs::path &df_structures_path,
+			 const char *old_version_name, const char *new_version_name,
+			 const fs::path &memory_layout_xml,
+			 const std::vector<std::string> &sections)
+{
+	Structures structures(df_structures_path);
+	auto old_version = find_version(structures, old_version_name);
+	auto new_version = find_version(structures, new_version_name);
+	if (!old_version || !new_version)
+		return EXIT_FAILURE;
+	dtml::LayoutDescription description(memory_layout_xml);
+
+	std::map<const ABI *, std::unique_ptr<MemoryLayout>> layouts;
+	auto generate = [&](const Structures::VersionInfo &version) {
+		const ABI &abi = ABI::fromVersionName(version.version_name);
+		auto &layout = layouts[&abi];
+		if (!layout)
+			layout = std::make_unique<MemoryLayout>(structures, abi);
+		auto result = dtml::Generator(structures, version, abi, *layout).generate(description);
+		for (const auto &error: result.errors)
+			std::cerr << std::format("{}: {}\n", version.version_name, error);
+		return result;
+	};
+	auto old_layout = generate(*old_version);
+	auto new_layout = generate(*new_version);
+	dtml::write_diff(std::cout, dtml::diff_layouts(old_layout, new_layout, sections));
+	return old_layout.ok() && new_layout.ok() ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+// Evaluate a layout for the same version with two df-structures trees,
+// loaded in parallel, and explain the changes.
+static int diff_structures(const fs::path &old_structures_path,
+			   const fs::path &new_structures_path,
+			   const char *version_name,
+			   const fs::path &memory_layout_xml,
+			   const std::vector<std::string> &sections)
+{
+	auto old_loading = std::async(std::launch::async, [&]() {
+		return std::make_unique<Structures>(old_structures_path);
+	});
+	auto new_structures = std::make_unique<Structures>(new_structures_path);
+	auto old_structures = old_loading.get();
+
+	auto old_version = find_version(*old_structures, version_name);
+	auto new_version = find_version(*new_structures, version_name);
+	if (!old_version || !new_version)
+		return EXIT_FAILURE;
+	const ABI &abi = ABI::fromVersionName(version_name);
+	dtml::LayoutDescription description(memory_layout_xml);
+
+	auto old_layout_loading = std::async(std::launch::async, [&]() {
+		return std::make_unique<MemoryLayout>(*old_structures, abi);
+	});
+	MemoryLayout new_layout(*new_structures, abi);
+	auto old_layout = old_layout_loading.get();
+
+	dtml::Generator old_generator(*old_structures, *old_version, abi, *old_layout);
+	dtml::Generator new_generator(*new_structures, *new_version, abi, new_layout);
+	auto old_result = old_generator.generate(description);
+	auto new_result = new_generator.generate(description);
+	for (const auto &error: old_result.errors)
+		std::cerr << std::format("{}: {}\n", old_structures_path.string(), error);
+	for (const auto &error: new_result.errors)
+		std::cerr << std::format("{}: {}\n", new_structures_path.string(), error);
+
+	auto changes = dtml::diff_layouts(old_result, new_result, sections);
+	for (auto &change: changes) {
+		if (auto entry = description.findEntry(change.section, change.name))
+			change.causes = dtml::explain_change(old_generator, new_generator, entry);
+	}
+	dtml::write_diff(std::cout, changes);
+	return old_result.ok() && new_result.ok() ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+static fs::path dump_file_name(std::string_view version_name)
+{
+	std::string name(version_name);
+	std::ranges::replace(name, ' ', '_');
+	return name + ".dump";
+}
+
+// Write one dump per version, the layout and dump are computed only once
+// per ABI. With a single version, output is the file name, otherwise it is
+// a directory.
+static int dump_all(const fs::path &df_structures_path,
+		    std::span<const char *const> version_names,
+		    const fs::path &output)
+{
+	Structures structures(df_structures_path);
+	std::map<const ABI *, std::string> dumps;
 	bool ok = true;
-	for (auto child: element.children()) {
-		if (child.type() != node_element)
+	for (auto version_name: version_names) {
+		if (!find_version(structures, version_name)) {
+			ok = false;
 			continue;
-		std::string_view entry_name = child.attribute("name").value();
-
-		const Compound *type = nullptr;
-		if (auto type_attr = child.attribute("type")) {
-			std::string_view type_name = type_attr.value();
-			type = structures.findCompound(parse_path(type_name));
-			if (!type) {
-				std::cerr << std::format("type {} not found for entry {}.\n",
-						type_attr.value(),
-						entry_name);
-				ok = false;
-				continue;
-			}
 		}
+		const ABI &abi = ABI::fromVersionName(version_name);
+		auto [it, inserted] = dumps.try_emplace(&abi);
+		if (inserted) {
+			MemoryLayout layout(structures, abi);
+			std::vector<std::string> errors;
+			it->second = dtml::make_layout_dump(layout, abi.pointer.size, errors);
+			for (const auto &error: errors)
+				std::cerr << error << "\n";
+		}
+		auto path = version_names.size() == 1 ? output : output / dump_file_name(version_name);
+		if (!write_if_changed(path, it->second))
+			ok = false;
+	}
+	return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
 
-		std::string_view name = child.name();
-		if (name == "offset") {
-			if (!type) {
-				std::cerr << std::format("offset {} need a type.\n", entry_name);
-				ok = false;
-				continue;
-			}
-			std::string_view member = child.attribute("member").value();
+#ifdef HAVE_INOTIFY
+static int watch(const fs::path &df_structures_path, const char *version_name,
+		 const fs::path &memory_layout_xml, const std::optional<fs::path> &output,
+		 const dtml::GenerateOptions &options, OutputFormat format)
+{
+	using clock = std::chrono::steady_clock;
+	FileWatcher watcher;
+	auto watched_structures = watcher.addDirectory(df_structures_path);
+	auto layout_dir = memory_layout_xml.parent_path();
+	if (layout_dir.empty())
+		layout_dir = ".";
+	auto watched_layout = watcher.addDirectory(layout_dir) / memory_layout_xml.filename();
+
+	std::unique_ptr<Structures> structures;
+	bool reload_structures = true;
+	while (true) {
+		auto start = clock::now();
+		if (reload_structures) {
 			try {
-				auto [member_type, offset] = layout.getOffset(*type, parse_path(member));
-				print_value(entry_name, offset);
+				structures.reset();
+				structures = std::make_unique<Structures>(df_structures_path);
 			}
 			catch (std::exception &e) {
-				std::cerr << std::format("Failed to get member {} offset for {}: {}.\n", member, entry_name, e.what());
-				ok = false;
-				continue;
+				std::cerr << std::format("Could not load structures: {}\n", e.what());
 			}
 		}
-		else if (name == "size") {
-			if (!type) {
-				std::cerr << std::format("size {} need a type.\n", entry_name);
-				ok = false;
-				continue;
-			}
-			auto it = layout.type_info.find(type);
-			if (it == layout.type_info.end()) {
-				std::cerr << std::format("Missing type info for size {}.\n", entry_name);
-				ok = false;
-				continue;
-			}
-			print_value(entry_name, it->second.size);
-		}
-		else if (name == "vmethod") {
-			if (!type) {
-				std::cerr << std::format("vmethod {} need a type.\n", entry_name);
-				ok = false;
-				continue;
-			}
-			std::string_view method = child.attribute("method").value();
-			auto vtable_index = type->methodIndex(method);
-			if (vtable_index == -1) {
-				std::cerr << std::format("Method {} not found for vmethod {}.\n", method, entry_name);
-				ok = false;
-			}
-			else {
-				print_value(entry_name, vtable_index * abi.pointer.size);
-			}
-		}
-		else if (name == "value") {
-			int value = 0;
-			if (auto enum_name = child.attribute("enum")) {
-				if (auto enum_type = structures.findEnum(enum_name.value())) {
-					std::string_view value_name = child.attribute("value").value();
-					auto value_it = enum_type->values.find(value_name);
-					if (value_it != enum_type->values.end())
-						value = value_it->second.value;
-					else {
-						std::cerr << std::format("Unknown enum value {} in {}.\n", value_name, enum_name.value());
-						ok = false;
-						continue;
-					}
-				}
-				else {
-					std::cerr << std::format("Unknown enum {}.\n", enum_name.value());
-					ok = false;
-					continue;
-				}
-			}
-			else
-				value = child.attribute("value").as_int();
-			print_value(entry_name, value);
-		}
-		else if (name == "global") {
-			std::string_view object = child.attribute("object").value();
+		if (structures) {
+			std::ostringstream out;
+			bool ok = false;
 			try {
-				auto ptr = Pointer::fromGlobal(structures, version, layout, parse_path(object));
-				print_value(entry_name, ptr.address);
+				ok = generate(out, *structures, version_name, memory_layout_xml, options, format);
 			}
 			catch (std::exception &e) {
-				std::cerr << std::format("Global object {}: {}\n", object, e.what());
-				ok = false;
+				std::cerr << std::format("Failed to generate memory layout: {}\n", e.what());
 			}
+			if (!output)
+				std::cout << out.view() << std::flush;
+			else if (ok)
+				write_if_changed(*output, out.view());
+			auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(clock::now() - start);
+			std::cerr << std::format("{} in {} ms\n",
+					ok ? "Generated memory layout" : "Generation failed",
+					elapsed.count());
 		}
-		else if (name == "vtable") {
-			std::string_view type = child.attribute("type").value();
-			auto it = version.vtables_addresses.find(type);
-			if (it != version.vtables_addresses.end()) {
-				print_value(entry_name, it->second);
-			}
-			else {
-				std::cerr << std::format("Failed to find vtable for {}.\n", entry_name);
-				ok = false;
+
+		// Wait for a relevant change
+		bool layout_changed = false;
+		reload_structures = false;
+		while (!reload_structures && !layout_changed) {
+			for (const auto &path: watcher.wait()) {
+				if (path == watched_layout)
+					layout_changed = true;
+				else if (path.parent_path() == watched_structures && path.extension() == ".xml")
+					reload_structures = true;
 			}
 		}
-		else {
-			std::cerr << std::format("Invalid tag name: {}.\n", name);
-			ok = false;
-		}
 	}
-	return ok;
 }
+#endif
 
-static bool print_flag_array(const Structures &structures, const xml_node element)
-{
-	std::string_view bitfield_name = element.attribute("bitfield").value();
-	auto bitfield = structures.findBitfield(bitfield_name);
-	if (!bitfield) {
-		std::cerr << std::format("Unknown bitfield {}.\n", bitfield_name);
-		return false;
-	}
+using stats_clock = std::chrono::steady_clock;
 
-	bool ok = true;
-	std::vector<std::tuple<std::string_view, std::size_t>> values;
-	for (auto child: element.children()) {
-		if (child.type() != node_element)
-			continue;
-		std::string_view name = child.name();
-		if (name != "flag") {
-			std::cerr << std::format("invalid tagname {} in flag-array.\n", name);
-			ok = false;
-			continue;
-		}
-		std::string_view flags = child.attribute("flags").value();
-		int value = 0;
-		for (auto flag_name_range: flags | std::views::split('|')) {
-			auto flag_name = std::string_view(std::begin(flag_name_range), std::end(flag_name_range));
-			auto flag_it = std::ranges::find(bitfield->flags, flag_name, &Bitfield::Flag::name);
-			if (flag_it != bitfield->flags.end()) {
-				if (flag_it->count != 1) {
-					std::cerr << std::format("{} is not a single bit flag.\n", flag_name);
-					ok = false;
-					continue;
-				}
-				value |= 1 << flag_it->offset;
-			}
-			else {
-				std::cerr << std::format("Unknown flag value {} in {}.\n", flag_name, bitfield_name);
-				ok = false;
-				continue;
-			}
-		}
-		values.emplace_back(child.attribute("name").value(), value);
-	}
+static void print_stats(std::string_view phase, stats_clock::duration duration, AllocationCounter allocations)
+{
+	auto ms = std::chrono::duration_cast<std::chrono::duration<double, std::milli>>(duration).count();
+	if (AllocationCounter::enabled())
+		std::cerr << std::format("{}: {} ms, {} heap allocations ({} bytes)\n",
+				phase, ms, allocations.count, allocations.bytes);
+	else
+		std::cerr << std::format("{}: {} ms\n", phase, ms);
+}
 
-	std::cout << std::format("size={}\n", values.size());
-	for (unsigned int i = 0; i < values.size(); ++i) {
-		std::cout << std::format("{}\\name=\"{}\"\n", i+1, std::get<0>(values[i]));
-		std::cout << std::format("{}\\value={:#010x}\n", i+1, std::get<1>(values[i]));
-	}
-	return ok;
+static void usage(const char *argv0)
+{
+	std::cerr << std::format("Usage: {} [options] df_structures_path version_name memory_layout_xml\n", argv0);
+	std::cerr << std::format("       {} --repl df_structures_path version_name\n", argv0);
+	std::cerr << std::format("       {} --diff version_a version_b [--section NAME]... df_structures_path memory_layout_xml\n", argv0);
+	std::cerr << std::format("       {} --compare-structures old_df_structures_path [--section NAME]... df_structures_path version_name memory_layout_xml\n", argv0);
+#ifdef HAVE_GIT_SOURCES
+	std::cerr << std::format("       {} --bisect-entry SECTION/NAME REPOSITORY@OLD..NEW version_name memory_layout_xml\n", argv0);
+#endif
+	std::cerr << std::format("       {} --dump-all --output FILE_OR_DIR df_structures_path version_name...\n", argv0);
+#ifdef HAVE_GIT_SOURCES
+	std::cerr << std::format("df_structures_path may be REPOSITORY@REV to read the XML files from a git\n");
+	std::cerr << std::format("repository without checking it out.\n");
+#endif
+	std::cerr << std::format("df_structures_path may be a .tar, .tar.gz or .zip archive.\n");
+	std::cerr << std::format("Options:\n");
+	std::cerr << std::format("  --output FILE     write the ini to FILE instead of the standard output,\n");
+	std::cerr << std::format("                    FILE is not modified if its content is unchanged\n");
+	std::cerr << std::format("  --depfile FILE    write a Make/Ninja depfile listing the input files\n");
+	std::cerr << std::format("  --cpp-header      write a C++ header with a packed struct per section and\n");
+	std::cerr << std::format("                    type instead of the ini\n");
+	std::cerr << std::format("  --read-plans      add a SECTION_read_plan section with the merged byte\n");
+	std::cerr << std::format("                    ranges of the members of each type in the section\n");
+	std::cerr << std::format("  --abi-section     add an abi section with the pointer size and the layout\n");
+	std::cerr << std::format("                    of std::vector and std::string\n");
+	std::cerr << std::format("  --extents         add a SECTION_extents section with the end of the last\n");
+	std::cerr << std::format("                    member used and the size of each type\n");
+	std::cerr << std::format("  --flag-masks      add a flag_masks section with the combined mask of each\n");
+	std::cerr << std::format("                    flag-array\n");
+	std::cerr << std::format("  --pointer-chains  add a SECTION_chains section with the base address and\n");
+	std::cerr << std::format("                    offsets after each dereference of every global\n");
+	std::cerr << std::format("  --strides         add a SECTION_strides section with the item size of\n");
+	std::cerr << std::format("                    vector globals and members\n");
+	std::cerr << std::format("  --typed           add a SECTION_types section with the size and kind of\n");
+	std::cerr << std::format("                    the member of each offset\n");
+#ifdef HAVE_INOTIFY
+	std::cerr << std::format("  --watch           keep running and regenerate the output when the input\n");
+	std::cerr << std::format("                    files are modified\n");
+#endif
+	std::cerr << std::format("  --repl            answer offset/size/vmethod/... queries read from the\n");
+	std::cerr << std::format("                    standard input (type help for the list)\n");
+	std::cerr << std::format("  --diff A B        print the entries whose value differs between versions A\n");
+	std::cerr << std::format("                    and B\n");
+	std::cerr << std::format("  --compare-structures PATH\n");
+	std::cerr << std::format("                    print the entries whose value differs when using the\n");
+	std::cerr << std::format("                    df-structures from PATH, and the structure changes causing it\n");
+	std::cerr << std::format("  --section NAME    only compare section NAME (may be repeated)\n");
+#ifdef HAVE_GIT_SOURCES
+	std::cerr << std::format("  --bisect-entry SECTION/NAME\n");
+	std::cerr << std::format("                    find the first df-structures commit in OLD..NEW where\n");
+	std::cerr << std::format("                    the value of the entry changes\n");
+#endif
+	std::cerr << std::format("  --dump-all        write the flattened layout of every compound in a binary\n");
+	std::cerr << std::format("                    file (see LayoutDump.h), with several versions --output\n");
+	std::cerr << std::format("                    is a directory\n");
+	std::cerr << std::format("  --stats           print timings and allocation counts on stderr\n");
+	std::cerr << std::format("  --no-cache        always regenerate the output\n");
+	std::cerr << std::format("  --cache-dir DIR   directory for cached outputs (default: {})\n",
+			InputCache::defaultDirectory().value_or("none").string());
 }
 
 int main(int argc, char *argv[]) try
 {
-	if (argc != 4) {
-		std::cerr << std::format("Usage: {} df_structures_path version_name memory_layout_xml\n", argv[0]);
-		return EXIT_FAILURE;
-	}
-	fs::path df_structures_path = argv[1];
-	const char *version_name = argv[2];
-	fs::path memory_layout_xml = argv[3];
-
-	Structures structures(df_structures_path);
+	PugiArena::install();
+	auto start_time = stats_clock::now();
+	auto start_allocations = AllocationCounter::current();
 
-	auto version = structures.versionByName(version_name);
-	if (!version) {
-		std::cerr << std::format("Version \"{}\" not found\n", version_name);
-		std::cerr << std::format("Available versions are:\n");
-		for (const auto &version: structures.allVersions())
-			std::cerr << std::format(" - {}\n", version.version_name);
-		return EXIT_FAILURE;
+	bool use_cache = true;
+	bool show_stats = false;
+	bool repl_mode = false;
+	bool dump_mode = false;
+	std::optional<std::pair<const char *, const char *>> diff_versions_arg;
+	std::vector<std::string> diff_sections;
+	std::optional<fs::path> compare_structures;
+#ifdef HAVE_GIT_SOURCES
+	const char *bisect_entry_arg = nullptr;
+#endif
+#ifdef HAVE_INOTIFY
+	bool watch_mode = false;
+#endif
+	dtml::GenerateOptions options;
+	OutputFormat format = OutputFormat::Ini;
+	std::string options_key; // options changing the output, for the cache
+	std::optional<fs::path> cache_dir = InputCache::defaultDirectory();
+	std::optional<fs::path> output, depfile;
+	std::vector<const char *> args;
+	for (int i = 1; i < argc; ++i) {
+		std::string_view arg = argv[i];
+		if (arg == "--no-cache")
+			use_cache = false;
+		else if (arg == "--cache-dir" && i+1 < argc)
+			cache_dir = argv[++i];
+#ifdef HAVE_INOTIFY
+		else if (arg == "--watch")
+			watch_mode = true;
+#endif
+		else if (arg == "--repl")
+			repl_mode = true;
+		else if (arg == "--diff" && i+2 < argc) {
+			diff_versions_arg.emplace(argv[i+1], argv[i+2]);
+			i += 2;
+		}
+		else if (arg == "--compare-structures" && i+1 < argc)
+			compare_structures = argv[++i];
+#ifdef HAVE_GIT_SOURCES
+		else if (arg == "--bisect-entry" && i+1 < argc)
+			bisect_entry_arg = argv[++i];
+#endif
+		else if (arg == "--section" && i+1 < argc)
+			diff_sections.push_back(argv[++i]);
+		else if (arg == "--dump-all")
+			dump_mode = true;
+		else if (arg == "--read-plans") {
+			options.read_plans = true;
+			options_key += "read-plans;";
+		}
+		else if (arg == "--abi-section") {
+			options.abi_section = true;
+			options_key += "abi-section;";
+		}
+		else if (arg == "--extents") {
+			options.extents = true;
+			options_key += "extents;";
+		}
+		else if (arg == "--flag-masks") {
+			options.flag_masks = true;
+			options_key += "flag-masks;";
+		}
+		else if (arg == "--pointer-chains") {
+			options.pointer_chains = true;
+			options_key += "pointer-chains;";
+		}
+		else if (arg == "--strides") {
+			options.strides = true;
+			options_key += "strides;";
+		}
+		else if (arg == "--typed") {
+			options.typed = true;
+			options_key += "typed;";
+		}
+		else if (arg == "--cpp-header") {
+			format = OutputFormat::CppHeader;
+			options_key += "cpp-header;";
+		}
+		else if (arg == "--stats")
+			show_stats = true;
+		else if (arg == "--output" && i+1 < argc)
+			output = argv[++i];
+		else if (arg == "--depfile" && i+1 < argc)
+			depfile = argv[++i];
+		else if (arg.starts_with("--")) {
+			usage(argv[0]);
+			return EXIT_FAILURE;
+		}
+		else
+			args.push_back(argv[i]);
 	}
-
-	const ABI &abi = ABI::fromVersionName(version_name);
-
-	MemoryLayout layout(structures, abi);
-
-	std::cout << std::format("[info]\n");
-	if (version->id.size() < 4) {
-		std::cerr << std::format("Invalid version id, size is too small: {}\n", version->id.size());
-		return EXIT_FAILURE;
+	if (repl_mode) {
+		if (args.size() != 2) {
+			usage(argv[0]);
+			return EXIT_FAILURE;
+		}
+		return repl(structures_directory(args[0], cache_dir), args[1]);
 	}
-	std::cout << std::format("checksum=0x{:02x}{:02x}{:02x}{:02x}\n",
-			version->id[0],
-			version->id[1],
-			version->id[2],
-			version->id[3]);
-	std::cout << std::format("version_name={}\n", version_name);
-	std::cout << std::format("complete=true\n");
-	std::cout << std::format("\n");
-
-	xml_document doc;
-	auto res = doc.load_file(memory_layout_xml.c_str());
-	if (!res) {
-		std::cerr << std::format("Failed to parse memory layout xml: {}\n", res.description());
+	if (diff_versions_arg) {
+		if (args.size() != 2) {
+			usage(argv[0]);
+			return EXIT_FAILURE;
+		}
+		return diff_versions(structures_directory(args[0], cache_dir),
+				diff_versions_arg->first, diff_versions_arg->second,
+				args[1], diff_sections);
+	}
+	if (compare_structures) {
+		if (args.size() != 3) {
+			usage(argv[0]);
+			return EXIT_FAILURE;
+		}
+		return diff_structures(structures_directory(compare_structures->string(), cache_dir),
+				structures_directory(args[0], cache_dir),
+				args[1], args[2], diff_sections);
+	}
+#ifdef HAVE_GIT_SOURCES
+	if (bisect_entry_arg) {
+		fs::path repository;
+		std::string range;
+		if (args.size() != 3 || !parse_git_source(args[0], repository, range)) {
+			usage(argv[0]);
+			return EXIT_FAILURE;
+		}
+		GitRepository git(repository);
+		auto root = cache_dir.value_or(fs::temp_directory_path() / "dt-memory-layout");
+		return bisect_entry(git, range, bisect_entry_arg, args[1], args[2], root / "git");
+	}
+#endif
+	if (dump_mode) {
+		if (args.size() < 2 || !output) {
+			usage(argv[0]);
+			return EXIT_FAILURE;
+		}
+		return dump_all(structures_directory(args[0], cache_dir), std::span(args).subspan(1), *output);
+	}
+	if (args.size() != 3 || (depfile && !output)) {
+		usage(argv[0]);
 		return EXIT_FAILURE;
 	}
+	// Archives are only extracted when the structures must be loaded
+	std::optional<StructuresDirectory> structures_dir;
+	auto df_structures_path = [&]() -> const fs::path & {
+		if (!structures_dir)
+			structures_dir.emplace(structures_directory(args[0], cache_dir));
+		return structures_dir->path;
+	};
+	const char *version_name = args[1];
+	fs::path memory_layout_xml = args[2];
 
-	bool failed = false;
-	for (auto element: doc.document_element().children()) {
-		if (element.type() != node_element)
-			continue;
-		std::string_view name = element.name();
+#ifdef HAVE_INOTIFY
+	if (watch_mode)
+		return watch(df_structures_path(), version_name, memory_layout_xml, output, options, format);
+#endif
 
-		std::cout << std::format("[{}]\n", element.attribute("name").value());
-		if (name == "section") {
-			if (!print_section(structures, *version, abi, layout, element))
-				failed = true;
+	auto write_output = [&](std::string_view content) {
+		if (!output) {
+			std::cout << content << std::flush;
+			return true;
 		}
-		else if (name == "flag-array") {
-			if (!print_flag_array(structures, element))
-				failed = true;
+		if (!write_if_changed(*output, content))
+			return false;
+		if (depfile) {
+			auto dependencies = structures_dependencies(args[0]);
+			dependencies.push_back(memory_layout_xml);
+			if (!write_depfile(*depfile, *output, dependencies))
+				return false;
 		}
-		else {
-			std::cerr << std::format("Ignoring unknown tag name: {}\n", name);
-			failed = true;
-			continue;
+		return true;
+	};
+
+	// A cache hit skips loading the structures entirely
+	std::optional<InputCache> cache;
+	if (use_cache && cache_dir)
+		cache.emplace(*cache_dir, hash_inputs(
+				is_structures_archive(args[0]) ? fs::path(args[0]) : df_structures_path(),
+				version_name, memory_layout_xml, options_key));
+	if (cache) {
+		if (auto content = cache->load()) {
+			if (show_stats)
+				print_stats("Cache hit",
+						stats_clock::now() - start_time,
+						AllocationCounter::current() - start_allocations);
+			return write_output(*content) ? EXIT_SUCCESS : EXIT_FAILURE;
 		}
-		std::cout << std::endl;
 	}
-	return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+
+	auto load_time = stats_clock::now();
+	auto load_allocations = AllocationCounter::current();
+	Structures structures(df_structures_path());
+	// the extracted files are no longer needed
+	structures_dir.reset();
+	auto generate_time = stats_clock::now();
+	auto generate_allocations = AllocationCounter::current();
+	std::ostringstream out;
+	bool ok = generate(out, structures, version_name, memory_layout_xml, options, format);
+	if (show_stats) {
+		auto end_time = stats_clock::now();
+		auto end_allocations = AllocationCounter::current();
+		print_stats("Loading structures",
+				generate_time - load_time,
+				generate_allocations - load_allocations);
+		print_stats("Generating",
+				end_time - generate_time,
+				end_allocations - generate_allocations);
+		auto arena = PugiArena::stats();
+		std::cerr << std::format("pugixml arena: {} allocations ({} bytes) in {} chunks ({} bytes), {} rewinds\n",
+				arena.allocations, arena.bytes,
+				arena.chunks, arena.chunk_bytes,
+				arena.rewinds);
+	}
+	if (!ok) {
+		// Do not replace a previously generated file with a broken one
+		if (!output)
+			std::cout << out.view() << std::flush;
+		return EXIT_FAILURE;
+	}
+	if (cache)
+		cache->store(out.view());
+	return write_output(out.view()) ? EXIT_SUCCESS : EXIT_FAILURE;
 }
 catch (std::exception &e) {
 	std::cerr << std::format("Could not load structures: {}\n", e.what());
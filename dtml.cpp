@@ -0,0 +1,252 @@
+/*
+ * Copyright 2023 Clement Vuchener
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "dtml.h"
+
+#include <cstddef>
+#include <cstdlib>
+#include <cstring>
+#include <format>
+#include <map>
+#include <memory>
+#include <new>
+
+#include <dfs/Structures.h>
+#include <dfs/ABI.h>
+#include <dfs/MemoryLayout.h>
+using namespace dfs;
+
+#include "Generator.h"
+
+struct dtml_structures
+{
+	Structures structures;
+	std::map<const ABI *, std::unique_ptr<MemoryLayout>> layouts;
+
+	explicit dtml_structures(const char *path):
+		structures(path)
+	{
+	}
+
+	const MemoryLayout &layout(const ABI &abi)
+	{
+		auto &layout = layouts[&abi];
+		if (!layout)
+			layout = std::make_unique<MemoryLayout>(structures, abi);
+		return *layout;
+	}
+};
+
+static void set_error(char **error, std::string_view message)
+{
+	if (!error)
+		return;
+	*error = static_cast<char *>(std::malloc(message.size() + 1));
+	if (*error) {
+		std::memcpy(*error, message.data(), message.size());
+		(*error)[message.size()] = '\0';
+	}
+}
+
+// Size of the details of each entry in a section, 0 if there are none
+static std::size_t details_size(dtml::Section::Kind kind)
+{
+	switch (kind) {
+	case dtml::Section::Kind::FlagArray: return sizeof(dtml_flag_details);
+	case dtml::Section::Kind::ReadPlan: return sizeof(dtml_range_details);
+	case dtml::Section::Kind::Types: return sizeof(dtml_type_details);
+	default: return 0;
+	}
+}
+
+// Pack the generated layout in a single allocation: the dtml_result
+// header, followed by the section, entry, details and error pointer
+// arrays, then all the strings.
+static dtml_result *pack_result(const dtml::GeneratedLayout &layout)
+{
+	auto align = [](std::size_t offset, std::size_t alignment) {
+		return (offset + alignment - 1) / alignment * alignment;
+	};
+	// every details struct is aligned like uint64_t or a pointer
+	constexpr std::size_t details_align = alignof(std::max_align_t);
+
+	std::size_t entry_count = 0;
+	std::size_t details_total = 0;
+	std::size_t string_size = layout.version_name.size() + 1;
+	for (const auto &section: layout.sections) {
+		entry_count += section.entries.size();
+		details_total += align(section.entries.size() * details_size(section.kind), details_align);
+		string_size += section.name.size() + 1;
+		for (const auto &entry: section.entries)
+			string_size += entry.name.size() + 1;
+	}
+	for (const auto &error: layout.errors)
+		string_size += error.size() + 1;
+
+	std::size_t sections_offset = align(sizeof(dtml_result), alignof(dtml_section));
+	std::size_t entries_offset = align(sections_offset + layout.sections.size() * sizeof(dtml_section), alignof(dtml_entry));
+	std::size_t details_offset = align(entries_offset + entry_count * sizeof(dtml_entry), details_align);
+	std::size_t errors_offset = align(details_offset + details_total, alignof(const char *));
+	std::size_t strings_offset = errors_offset + layout.errors.size() * sizeof(const char *);
+	char *block = static_cast<char *>(std::malloc(strings_offset + string_size));
+	if (!block)
+		throw std::bad_alloc();
+
+	char *strings = block + strings_offset;
+	auto copy_string = [&strings](std::string_view str) {
+		const char *copy = strings;
+		std::memcpy(strings, str.data(), str.size());
+		strings[str.size()] = '\0';
+		strings += str.size() + 1;
+		return copy;
+	};
+
+	auto result = new (block) dtml_result;
+	auto sections = reinterpret_cast<dtml_section *>(block + sections_offset);
+	auto entries = reinterpret_cast<dtml_entry *>(block + entries_offset);
+	char *details = block + details_offset;
+	auto errors = reinterpret_cast<const char **>(block + errors_offset);
+	result->checksum = layout.checksum;
+	result->version_name = copy_string(layout.version_name);
+	result->section_count = layout.sections.size();
+	result->sections = sections;
+	result->error_count = layout.errors.size();
+	result->errors = errors;
+	for (const auto &section: layout.sections) {
+		auto s = new (sections++) dtml_section;
+		s->name = copy_string(section.name);
+		s->details = nullptr;
+		switch (section.kind) {
+		case dtml::Section::Kind::Values:
+			s->kind = DTML_SECTION_VALUES;
+			break;
+		case dtml::Section::Kind::FlagArray:
+			s->kind = DTML_SECTION_FLAG_ARRAY;
+			break;
+		case dtml::Section::Kind::ReadPlan:
+			s->kind = DTML_SECTION_READ_PLAN;
+			break;
+		case dtml::Section::Kind::Types:
+			s->kind = DTML_SECTION_TYPES;
+			break;
+		case dtml::Section::Kind::EnumTable:
+			s->kind = DTML_SECTION_ENUM_TABLE;
+			break;
+		}
+		s->entry_count = section.entries.size();
+		s->entries = entries;
+		for (const auto &entry: section.entries) {
+			auto e = new (entries++) dtml_entry;
+			e->name = copy_string(entry.name);
+			e->value = entry.value;
+		}
+		if (auto size = details_size(section.kind)) {
+			s->details = details;
+			for (const auto &entry: section.entries) {
+				switch (section.kind) {
+				case dtml::Section::Kind::FlagArray:
+					new (details) dtml_flag_details{entry.word, entry.expected};
+					break;
+				case dtml::Section::Kind::ReadPlan:
+					new (details) dtml_range_details{entry.length};
+					break;
+				case dtml::Section::Kind::Types:
+					// kind names are string literals
+					new (details) dtml_type_details{dtml::kind_name(entry.kind).data()};
+					break;
+				default:
+					break;
+				}
+				details += size;
+			}
+			details = block + align(details - block, details_align);
+		}
+	}
+	for (const auto &error: layout.errors)
+		*errors++ = copy_string(error);
+	return result;
+}
+
+extern "C" {
+
+unsigned int dtml_abi_version(void)
+{
+	return DTML_ABI_VERSION;
+}
+
+dtml_structures *dtml_open_structures(const char *df_structures_path, char **error)
+{
+	try {
+		return new dtml_structures(df_structures_path);
+	}
+	catch (std::exception &e) {
+		set_error(error, std::format("Could not load structures: {}", e.what()));
+		return nullptr;
+	}
+}
+
+void dtml_close_structures(dtml_structures *structures)
+{
+	delete structures;
+}
+
+dtml_result *dtml_generate(dtml_structures *structures,
+			   const char *version_name,
+			   const char *memory_layout_xml,
+			   char **error)
+{
+	return dtml_generate_ex(structures, version_name, memory_layout_xml, 0, error);
+}
+
+dtml_result *dtml_generate_ex(dtml_structures *structures,
+			      const char *version_name,
+			      const char *memory_layout_xml,
+			      unsigned int flags,
+			      char **error)
+{
+	try {
+		auto version = structures->structures.versionByName(version_name);
+		if (!version) {
+			set_error(error, std::format("Version \"{}\" not found", version_name));
+			return nullptr;
+		}
+		const ABI &abi = ABI::fromVersionName(version_name);
+		dtml::LayoutDescription description(memory_layout_xml);
+		dtml::Generator generator(structures->structures, *version, abi, structures->layout(abi));
+		dtml::GenerateOptions options;
+		options.read_plans = flags & DTML_GENERATE_READ_PLANS;
+		options.typed = flags & DTML_GENERATE_TYPES;
+		options.abi_section = flags & DTML_GENERATE_ABI;
+		options.strides = flags & DTML_GENERATE_STRIDES;
+		options.flag_masks = flags & DTML_GENERATE_FLAG_MASKS;
+		options.pointer_chains = flags & DTML_GENERATE_POINTER_CHAINS;
+		options.extents = flags & DTML_GENERATE_EXTENTS;
+		return pack_result(generator.generate(description, options));
+	}
+	catch (std::exception &e) {
+		set_error(error, e.what());
+		return nullptr;
+	}
+}
+
+void dtml_free(void *ptr)
+{
+	std::free(ptr);
+}
+
+} // extern "C"
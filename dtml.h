@@ -0,0 +1,165 @@
+/*
+ * Copyright 2023 Clement Vuchener
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef DTML_H
+#define DTML_H
+
+/*
+ * C API for generating memory layouts in-process.
+ *
+ * A dtml_structures handle keeps the loaded df-structures and the memory
+ * layouts computed for each ABI, so only the first dtml_generate call for
+ * an ABI pays for computing the layout. Handles are not thread-safe.
+ *
+ * Results are returned as a single allocation: every pointer inside a
+ * dtml_result points into the same block, which is released with one
+ * dtml_free call.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#if defined(_WIN32)
+#  ifdef DTML_BUILD
+#    define DTML_API __declspec(dllexport)
+#  else
+#    define DTML_API __declspec(dllimport)
+#  endif
+#else
+#  define DTML_API __attribute__((visibility("default")))
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Version of the structures below, incremented whenever their layout
+ * changes. Bindings should check that dtml_abi_version() returns the
+ * version they were written for.
+ */
+#define DTML_ABI_VERSION 2
+
+typedef struct dtml_structures dtml_structures;
+
+enum dtml_section_kind {
+	DTML_SECTION_VALUES = 0,
+	/* value is the mask of the flags, details are dtml_flag_details */
+	DTML_SECTION_FLAG_ARRAY = 1,
+	/* name is the type, value the start offset, details are
+	 * dtml_range_details */
+	DTML_SECTION_READ_PLAN = 2,
+	/* name is an offset entry, value its size, details are
+	 * dtml_type_details */
+	DTML_SECTION_TYPES = 3,
+	/* consecutive enum values, value is the enum value (two's complement
+	 * when negative) and name is empty in gaps */
+	DTML_SECTION_ENUM_TABLE = 4,
+};
+
+/* Optional sections for dtml_generate_ex, may be combined */
+enum dtml_generate_flags {
+	DTML_GENERATE_READ_PLANS = 1 << 0,
+	DTML_GENERATE_TYPES = 1 << 1,
+	DTML_GENERATE_ABI = 1 << 2,
+	DTML_GENERATE_STRIDES = 1 << 3,
+	DTML_GENERATE_FLAG_MASKS = 1 << 4,
+	DTML_GENERATE_POINTER_CHAINS = 1 << 5,
+	DTML_GENERATE_EXTENTS = 1 << 6,
+};
+
+typedef struct dtml_entry {
+	const char *name;
+	uint64_t value;
+} dtml_entry;
+
+/*
+ * Section kinds with more than a value per entry have a details array
+ * parallel to the entries, its type depends on the kind.
+ */
+typedef struct dtml_flag_details {
+	/* the flags are set when (word & value) == expected, with word the
+	 * bitfield word of this index */
+	uint32_t word;
+	uint64_t expected;
+} dtml_flag_details;
+
+typedef struct dtml_range_details {
+	uint64_t length;
+} dtml_range_details;
+
+typedef struct dtml_type_details {
+	const char *kind; /* "int32", "pointer", "std::vector"... */
+} dtml_type_details;
+
+typedef struct dtml_section {
+	const char *name;
+	int kind; /* enum dtml_section_kind */
+	size_t entry_count;
+	const dtml_entry *entries;
+	/* entry_count dtml_*_details depending on kind, or NULL */
+	const void *details;
+} dtml_section;
+
+typedef struct dtml_result {
+	uint32_t checksum;
+	const char *version_name;
+	size_t section_count;
+	const dtml_section *sections;
+	/* entries that could not be evaluated are missing from their section */
+	size_t error_count;
+	const char *const *errors;
+} dtml_result;
+
+/* DTML_ABI_VERSION of the library */
+DTML_API unsigned int dtml_abi_version(void);
+
+/*
+ * Load df-structures from a directory. Returns NULL on failure, and if
+ * error is not NULL, stores an error message that must be released with
+ * dtml_free.
+ */
+DTML_API dtml_structures *dtml_open_structures(const char *df_structures_path, char **error);
+
+DTML_API void dtml_close_structures(dtml_structures *structures);
+
+/*
+ * Evaluate a memory layout XML file for a version. Returns NULL if the
+ * version or the layout file cannot be used (error is set as with
+ * dtml_open_structures). The result must be released with dtml_free.
+ */
+DTML_API dtml_result *dtml_generate(dtml_structures *structures,
+				    const char *version_name,
+				    const char *memory_layout_xml,
+				    char **error);
+
+/* Same as dtml_generate with dtml_generate_flags */
+DTML_API dtml_result *dtml_generate_ex(dtml_structures *structures,
+				       const char *version_name,
+				       const char *memory_layout_xml,
+				       unsigned int flags,
+				       char **error);
+
+/* Release a result or an error message */
+DTML_API void dtml_free(void *ptr);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif